@@ -5,11 +5,16 @@ COMPILER_FLAGS="${COMPILER_FLAGS} -Wno-unused-variable"
 COMPILER_FLAGS="${COMPILER_FLAGS} -Wno-unused-function"
 
 LINKER_FLAGS="-lm -lX11 -lGL"
+HEADLESS_LINKER_FLAGS="-lm -lpthread"
 
 mkdir -p ../build
 pushd ../build > /dev/null
 
 clang ../code/platform_linux_main.c -O0 -DDEVELOPMENT_BUILD=1 $COMPILER_FLAGS -o sokoban_debug   $LINKER_FLAGS
 clang ../code/platform_linux_main.c -O2 -DDEVELOPMENT_BUILD=0 $COMPILER_FLAGS -o sokoban_release $LINKER_FLAGS
+clang ../code/platform_linux_main.c -O2 -DDEVELOPMENT_BUILD=0 -DRENDER_AT_NATIVE_RESOLUTION=1 $COMPILER_FLAGS -o sokoban_native $LINKER_FLAGS
+
+clang ../code/platform_headless_main.c -O0 -DDEVELOPMENT_BUILD=1 $COMPILER_FLAGS -o sokoban_headless_debug   $HEADLESS_LINKER_FLAGS
+clang ../code/platform_headless_main.c -O2 -DDEVELOPMENT_BUILD=0 $COMPILER_FLAGS -o sokoban_headless_release $HEADLESS_LINKER_FLAGS
 
 popd > /dev/null
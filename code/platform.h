@@ -77,6 +77,23 @@ function PLATFORM_LOAD_FILE(platform_load_file);
 #define PLATFORM_SAVE_FILE(name) bool name(char *file_path, void *memory, size_t size)
 function PLATFORM_SAVE_FILE(platform_save_file);
 
+// NOTE(law): Hand a file off to be written on a background thread. The memory
+// is copied before this returns. The write replaces the file atomically, and
+// repeated requests for the same path are coalesced so that only the latest
+// contents reach the disk.
+#define PLATFORM_QUEUE_SAVE_FILE(name) void name(char *file_path, void *memory, size_t size)
+function PLATFORM_QUEUE_SAVE_FILE(platform_queue_save_file);
+
+// NOTE(law): Hand bytes off to be appended to the end of a file on the same
+// background thread, ordered with respect to any queued saves of that file.
+#define PLATFORM_QUEUE_APPEND_FILE(name) void name(char *file_path, void *memory, size_t size)
+function PLATFORM_QUEUE_APPEND_FILE(platform_queue_append_file);
+
+// NOTE(law): Block until any queued writes of a file have reached the disk.
+// Call this before loading a file that the game may have queued a save of.
+#define PLATFORM_FLUSH_FILE(name) void name(char *file_path)
+function PLATFORM_FLUSH_FILE(platform_flush_file);
+
 #define PLATFORM_QUEUE_CALLBACK(name) void name(void *data)
 typedef PLATFORM_QUEUE_CALLBACK(queue_callback);
 
@@ -135,18 +152,36 @@ function bool was_pressed(struct platform_input_button button)
 #define SCREEN_TILE_COUNT_X 30
 #define SCREEN_TILE_COUNT_Y 20
 
+// NOTE(law): The art is presented at DISPLAY_BITMAP_SCALE times its source
+// resolution. By default the renderer draws it at that scale itself. Building
+// with RENDER_AT_NATIVE_RESOLUTION=1 rasterizes the art 1:1 instead, which is a
+// quarter of the pixels, and the platform layer makes up the difference with a
+// nearest-neighbour upscale of PRESENT_SCALE when it displays the output.
+// RESOLUTION_BASE is the size of the render output, and RESOLUTION_DISPLAY the
+// size of the window it is shown in.
+
+#if !defined(RENDER_AT_NATIVE_RESOLUTION)
+#   define RENDER_AT_NATIVE_RESOLUTION 0
+#endif
+
 #define SOURCE_BITMAP_DIMENSION_PIXELS 16
-#define TILE_BITMAP_SCALE 2
-#define TILE_DIMENSION_PIXELS (SOURCE_BITMAP_DIMENSION_PIXELS * TILE_BITMAP_SCALE)
+#define DISPLAY_BITMAP_SCALE 2
 
-// #define RENDER_TILE_COUNT_X 6
-// #define RENDER_TILE_COUNT_Y 4
-// #define TILES_PER_RENDER_TILE_X (SCREEN_TILE_COUNT_X / RENDER_TILE_COUNT_X)
-// #define TILES_PER_RENDER_TILE_Y (SCREEN_TILE_COUNT_Y / RENDER_TILE_COUNT_Y)
+#if RENDER_AT_NATIVE_RESOLUTION
+#   define TILE_BITMAP_SCALE 1
+#else
+#   define TILE_BITMAP_SCALE DISPLAY_BITMAP_SCALE
+#endif
+
+#define PRESENT_SCALE (DISPLAY_BITMAP_SCALE / TILE_BITMAP_SCALE)
+#define TILE_DIMENSION_PIXELS (SOURCE_BITMAP_DIMENSION_PIXELS * TILE_BITMAP_SCALE)
 
 #define RESOLUTION_BASE_WIDTH (SCREEN_TILE_COUNT_X * TILE_DIMENSION_PIXELS)
 #define RESOLUTION_BASE_HEIGHT (SCREEN_TILE_COUNT_Y * TILE_DIMENSION_PIXELS)
 
+#define RESOLUTION_DISPLAY_WIDTH (RESOLUTION_BASE_WIDTH * PRESENT_SCALE)
+#define RESOLUTION_DISPLAY_HEIGHT (RESOLUTION_BASE_HEIGHT * PRESENT_SCALE)
+
 #define SOUND_OUTPUT_HZ 48000
 #define SOUND_OUTPUT_CHANNEL_COUNT 2
 #define SOUND_OUTPUT_BYTES_PER_SAMPLE (SOUND_OUTPUT_CHANNEL_COUNT * sizeof(s16))
@@ -195,6 +230,7 @@ struct game_input
          struct platform_input_button charge;
 
          struct platform_input_button undo;
+         struct platform_input_button redo;
          struct platform_input_button reload;
 
          struct platform_input_button next;
@@ -209,6 +245,8 @@ struct game_input
    };
 };
 
+#include "platform_recording.h"
+
 #define GAME_UPDATE(name) void name(struct game_memory memory,          \
                                     struct game_renderer *renderer,     \
                                     struct game_input *input,           \
@@ -0,0 +1,1499 @@
+/* /////////////////////////////////////////////////////////////////////////// */
+/* (c) copyright 2023 Lawrence D. Kern /////////////////////////////////////// */
+/* /////////////////////////////////////////////////////////////////////////// */
+
+// NOTE(law): This is a windowless platform layer for running game code from the
+// command line, e.g. for verifying solutions in bulk. It depends only on POSIX,
+// so no display server, audio device or graphics API is required.
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef sem_t platform_semaphore;
+#include "platform.h"
+#include "sokoban.c"
+#include "renderer_software.c"
+
+#define HEADLESS_WORKER_THREAD_COUNT 8
+#define HEADLESS_LOG_MAX_LENGTH 1024
+
+#define HEADLESS_SECONDS_ELAPSED(start, end) ((double)((end).tv_sec - (start).tv_sec) \
+        + (1e-9 * (double)((end).tv_nsec - (start).tv_nsec)))
+
+// NOTE(law): While a recording is played back, file writes never reach the
+// disk. The save and solution files are kept in memory instead, and loads of
+// them are served from there. The session then starts from the recorded save,
+// only imports solutions it exported itself, and never touches the real files.
+#define HEADLESS_SANDBOX_FILE_COUNT 64
+
+struct headless_sandbox_file
+{
+   char file_path[256];
+   struct platform_file file;
+};
+
+global bool headless_global_is_sandboxed;
+global u32 headless_global_sandbox_file_count;
+global struct headless_sandbox_file headless_global_sandbox_files[HEADLESS_SANDBOX_FILE_COUNT];
+
+function u64 headless_read_cycle_counter(void)
+{
+   u64 result;
+#if __aarch64__
+   asm volatile("mrs %0, cntvct_el0" : "=r" (result));
+#else
+   result = __rdtsc();
+#endif
+   return(result);
+}
+
+#if DEVELOPMENT_BUILD
+function PLATFORM_TIMER_BEGIN(platform_timer_begin)
+{
+   global_platform_profiler.timers[id].id = id;
+   global_platform_profiler.timers[id].label = label;
+   global_platform_profiler.timers[id].start = headless_read_cycle_counter();
+}
+
+function PLATFORM_TIMER_END(platform_timer_end)
+{
+   global_platform_profiler.timers[id].elapsed += (headless_read_cycle_counter() - global_platform_profiler.timers[id].start);
+   global_platform_profiler.timers[id].hits++;
+}
+#endif
+
+function PLATFORM_LOG(platform_log)
+{
+#if DEVELOPMENT_BUILD
+   char message[HEADLESS_LOG_MAX_LENGTH];
+
+   va_list arguments;
+   va_start(arguments, format);
+   {
+      vsnprintf(message, sizeof(message), format, arguments);
+   }
+   va_end(arguments);
+
+   fprintf(stderr, "%s", message);
+#else
+   (void)format;
+#endif
+}
+
+function void *headless_allocate(size_t size)
+{
+   // NOTE(law): munmap() requires the size of the allocation in order to free
+   // the virtual memory. This function smuggles the allocation size just before
+   // the address that it actually returns. The header is padded out to
+   // RENDER_BITMAP_ALIGNMENT, so the result keeps that much of mmap's page
+   // alignment.
+
+   size_t allocation_size = size + RENDER_BITMAP_ALIGNMENT;
+   void *allocation = mmap(0, allocation_size, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+
+   if(allocation == MAP_FAILED)
+   {
+      platform_log("ERROR: Failed to allocate virtual memory.");
+      return(0);
+   }
+
+   void *result = (void *)((u8 *)allocation + RENDER_BITMAP_ALIGNMENT);
+   *((size_t *)result - 1) = allocation_size;
+
+   return(result);
+}
+
+function void headless_deallocate(void *memory)
+{
+   if(!memory)
+   {
+      return;
+   }
+
+   void *allocation = (void *)((u8 *)memory - RENDER_BITMAP_ALIGNMENT);
+   size_t allocation_size = *((size_t *)memory - 1);
+
+   if(munmap(allocation, allocation_size) != 0)
+   {
+      platform_log("ERROR: Failed to deallocate virtual memory.");
+   }
+}
+
+function PLATFORM_FREE_FILE(platform_free_file)
+{
+   if(file->memory)
+   {
+      headless_deallocate(file->memory);
+   }
+
+   zero_memory(file, sizeof(*file));
+}
+
+function struct platform_file headless_copy_file(void *memory, size_t size)
+{
+   struct platform_file result = {0};
+
+   if(size > 0)
+   {
+      result.memory = headless_allocate(size);
+      if(result.memory)
+      {
+         result.size = size;
+         copy_memory(result.memory, memory, size);
+      }
+   }
+
+   return(result);
+}
+
+function bool headless_is_sandbox_path(char *file_path)
+{
+   // NOTE(law): The save file, and the .lurd solutions that export_solution
+   // writes and import_solution reads.
+   char *extension = strrchr(file_path, '.');
+   bool result = (strcmp(file_path, SOKOBAN_SAVE_FILE_PATH) == 0 || (extension && strcmp(extension, ".lurd") == 0));
+   return(result);
+}
+
+function struct headless_sandbox_file *headless_get_sandbox_file(char *file_path, bool create)
+{
+   struct headless_sandbox_file *result = 0;
+   for(u32 index = 0; index < headless_global_sandbox_file_count; ++index)
+   {
+      if(strcmp(headless_global_sandbox_files[index].file_path, file_path) == 0)
+      {
+         result = headless_global_sandbox_files + index;
+         break;
+      }
+   }
+
+   if(!result && create && headless_global_sandbox_file_count < HEADLESS_SANDBOX_FILE_COUNT)
+   {
+      result = headless_global_sandbox_files + headless_global_sandbox_file_count++;
+      snprintf(result->file_path, sizeof(result->file_path), "%s", file_path);
+   }
+
+   return(result);
+}
+
+function PLATFORM_LOAD_FILE(platform_load_file)
+{
+   struct platform_file result = {0};
+
+   if(headless_global_is_sandboxed && headless_is_sandbox_path(file_path))
+   {
+      // NOTE(law): Files the session hasn't written (or been given) load empty.
+      struct headless_sandbox_file *sandbox = headless_get_sandbox_file(file_path, false);
+      if(sandbox)
+      {
+         result = headless_copy_file(sandbox->file.memory, sandbox->file.size);
+      }
+      return(result);
+   }
+
+   if(headless_global_is_sandboxed && strcmp(file_path, SOKOBAN_PROGRESS_FILE_PATH) == 0)
+   {
+      // NOTE(law): Personal bests only affect what is drawn, but start playback
+      // from none so that output doesn't depend on the machine's history.
+      return(result);
+   }
+
+   struct stat file_information;
+   if(stat(file_path, &file_information) == -1)
+   {
+      platform_log("ERROR: Failed to read file size of file: \"%s\".\n", file_path);
+      return(result);
+   }
+
+   int file = open(file_path, O_RDONLY);
+   if(file == -1)
+   {
+      platform_log("ERROR: Failed to open file: \"%s\".\n", file_path);
+      return(result);
+   }
+
+   size_t size = file_information.st_size;
+
+   result.memory = headless_allocate(size);
+   if(result.memory)
+   {
+      result.size = size;
+      read(file, result.memory, result.size);
+   }
+   else
+   {
+      platform_log("ERROR: Failed to allocate memory for file: \"%s\".\n", file_path);
+   }
+
+   close(file);
+
+   return(result);
+}
+
+function PLATFORM_SAVE_FILE(platform_save_file)
+{
+   bool result = false;
+
+   if(headless_global_is_sandboxed)
+   {
+      struct headless_sandbox_file *sandbox = 0;
+      if(headless_is_sandbox_path(file_path))
+      {
+         sandbox = headless_get_sandbox_file(file_path, true);
+      }
+
+      if(sandbox)
+      {
+         platform_free_file(&sandbox->file);
+         sandbox->file = headless_copy_file(memory, size);
+      }
+
+      result = true;
+      return(result);
+   }
+
+   int file = open(file_path, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+   if(file != -1)
+   {
+      ssize_t bytes_written = write(file, memory, size);
+      result = (bytes_written == size);
+
+      if(!result)
+      {
+         platform_log("ERROR (%d): Failed to write file: \"%s\".\n", errno, file_path);
+      }
+
+      close(file);
+   }
+   else
+   {
+      platform_log("ERROR (%d): Failed to open file: \"%s\".\n", errno, file_path);
+   }
+
+   return(result);
+}
+
+function PLATFORM_QUEUE_SAVE_FILE(platform_queue_save_file)
+{
+   // NOTE(law): The headless tool has no frame rate to protect, so queued saves
+   // are written immediately. This also keeps playback deterministic.
+   platform_save_file(file_path, memory, size);
+}
+
+function PLATFORM_QUEUE_APPEND_FILE(platform_queue_append_file)
+{
+   if(headless_global_is_sandboxed)
+   {
+      return;
+   }
+
+   int file = open(file_path, O_WRONLY|O_CREAT|O_APPEND, 0666);
+   if(file != -1)
+   {
+      ssize_t bytes_written = write(file, memory, size);
+      if(bytes_written != size)
+      {
+         platform_log("ERROR (%d): Failed to append to file: \"%s\".\n", errno, file_path);
+      }
+
+      close(file);
+   }
+   else
+   {
+      platform_log("ERROR (%d): Failed to open file: \"%s\".\n", errno, file_path);
+   }
+}
+
+function PLATFORM_FLUSH_FILE(platform_flush_file)
+{
+   // NOTE(law): Queued writes have already happened, so there is nothing to wait
+   // on.
+   (void)file_path;
+}
+
+function PLATFORM_ENQUEUE_WORK(platform_enqueue_work)
+{
+   u32 new_write_index = (queue->write_index + 1) % ARRAY_LENGTH(queue->entries);
+   assert(new_write_index != queue->read_index);
+
+   struct platform_work_queue_entry *entry = queue->entries + queue->write_index;
+   entry->data = data;
+   entry->callback = callback;
+
+   queue->completion_target++;
+
+   asm volatile("" ::: "memory");
+
+   queue->write_index = new_write_index;
+   sem_post(&queue->semaphore);
+}
+
+function bool headless_dequeue_work(struct platform_work_queue *queue)
+{
+   // NOTE(law): Return whether this thread should be made to wait until more
+   // work becomes available.
+
+   u32 read_index = queue->read_index;
+   u32 new_read_index = (read_index + 1) % ARRAY_LENGTH(queue->entries);
+   if(read_index == queue->write_index)
+   {
+      return(true);
+   }
+
+   u32 index = __sync_val_compare_and_swap(&queue->read_index, read_index, new_read_index);
+   if(index == read_index)
+   {
+      struct platform_work_queue_entry entry = queue->entries[index];
+      entry.callback(entry.data);
+
+      __sync_add_and_fetch(&queue->completion_count, 1);
+   }
+
+   return(false);
+}
+
+function PLATFORM_COMPLETE_QUEUE(platform_complete_queue)
+{
+   while(queue->completion_target > queue->completion_count)
+   {
+      headless_dequeue_work(queue);
+   }
+
+   queue->completion_target = 0;
+   queue->completion_count = 0;
+}
+
+function void *headless_thread_procedure(void *parameter)
+{
+   struct platform_work_queue *queue = (struct platform_work_queue *)parameter;
+
+   while(1)
+   {
+      if(headless_dequeue_work(queue))
+      {
+         sem_wait(&queue->semaphore);
+      }
+   }
+
+   return(0);
+}
+
+function u32 headless_get_processor_count(void)
+{
+   u32 result = sysconf(_SC_NPROCESSORS_ONLN);
+   return(result);
+}
+
+function void headless_start_worker_threads(struct platform_work_queue *queue)
+{
+   u32 processor_count = headless_get_processor_count();
+   u32 worker_thread_count = MINIMUM(processor_count, HEADLESS_WORKER_THREAD_COUNT);
+
+   sem_init(&queue->semaphore, 0, 0);
+
+   for(u32 index = 1; index < worker_thread_count; ++index)
+   {
+      pthread_t id;
+      if(pthread_create(&id, 0, headless_thread_procedure, queue) != 0)
+      {
+         platform_log("ERROR: Failed to create thread %u.\n", index);
+         continue;
+      }
+
+      pthread_detach(id);
+   }
+}
+
+function u64 headless_hash_bytes(u64 hash, void *memory, size_t size)
+{
+   // NOTE(law): 64-bit FNV-1a, continuing from hash.
+   u64 result = hash;
+
+   u8 *bytes = (u8 *)memory;
+   for(size_t index = 0; index < size; ++index)
+   {
+      result ^= bytes[index];
+      result *= 0x100000001b3;
+   }
+
+   return(result);
+}
+
+function u64 headless_hash_bitmap(struct render_bitmap bitmap)
+{
+   // NOTE(law): 64-bit FNV-1a over the pixels, for comparing final frames
+   // between runs.
+   u64 result = 0xcbf29ce484222325;
+
+   for(s32 y = 0; y < bitmap.height; ++y)
+   {
+      result = headless_hash_bytes(result, bitmap.memory + (y * bitmap.pitch), bitmap.width * sizeof(u32));
+   }
+
+   return(result);
+}
+
+function int headless_playback(int argument_count, char **arguments)
+{
+   // NOTE(law): Usage: playback <recording>
+   // Feed a recording made with `sokoban --record` back through game_update
+   // with the software renderer drawing into an offscreen bitmap.
+
+   if(argument_count != 1)
+   {
+      fprintf(stderr, "usage: playback <recording>\n");
+      return(1);
+   }
+
+   struct platform_file recording = platform_load_file(arguments[0]);
+   struct input_recording_header *header = (struct input_recording_header *)recording.memory;
+   if(recording.size < sizeof(*header) ||
+      header->magic_number != INPUT_RECORDING_MAGIC_NUMBER ||
+      header->version != INPUT_RECORDING_VERSION ||
+      recording.size < sizeof(*header) + header->save_size)
+   {
+      fprintf(stderr, "ERROR: \"%s\" is not a valid input recording.\n", arguments[0]);
+      return(1);
+   }
+
+   u8 *save = (u8 *)(header + 1);
+   struct input_recording_frame *frames = (struct input_recording_frame *)(save + header->save_size);
+   size_t frame_count = (recording.size - sizeof(*header) - header->save_size) / sizeof(*frames);
+
+   headless_global_is_sandboxed = true;
+   headless_get_sandbox_file(SOKOBAN_SAVE_FILE_PATH, true)->file = headless_copy_file(save, header->save_size);
+
+   struct platform_work_queue queue = {0};
+   headless_start_worker_threads(&queue);
+
+   // NOTE(law) Set up the rendering bitmap.
+   struct game_renderer *renderer = headless_allocate(sizeof(struct game_renderer));
+   initialize_software_renderer(renderer);
+
+   renderer->output.width = RESOLUTION_BASE_WIDTH;
+   renderer->output.height = RESOLUTION_BASE_HEIGHT;
+   renderer->output.pitch = RENDER_BITMAP_PITCH(RESOLUTION_BASE_WIDTH);
+   renderer->output.memory = headless_allocate(renderer->output.pitch * renderer->output.height * sizeof(u32));
+
+   // NOTE(law): Initialize game memory.
+   struct game_memory memory = {0};
+   memory.size = 512 * 1024 * 1024;
+   memory.base_address = headless_allocate(memory.size);
+
+   // NOTE(law): Mix a fixed 60th of a second of sound each frame, so that the
+   // mixer runs and its output can be hashed like the frames are.
+   struct game_sound_output sound = {0};
+   sound.max_sample_count = (u32)(SOUND_OUTPUT_HZ * 2.0f / 60.0f);
+   sound.frame_sample_count = SOUND_OUTPUT_HZ / 60;
+   sound.samples = headless_allocate(sound.max_sample_count * SOUND_OUTPUT_BYTES_PER_SAMPLE);
+
+   if(!renderer->output.memory || !memory.base_address || !sound.samples)
+   {
+      return(1);
+   }
+
+   struct game_input input = {0};
+   u64 sound_hash = 0xcbf29ce484222325;
+
+   struct timespec start;
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   for(size_t frame_index = 0; frame_index < frame_count; ++frame_index)
+   {
+      float frame_seconds_elapsed = unpack_input_frame(frames[frame_index], &input);
+      game_update(memory, renderer, &input, &sound, &queue, frame_seconds_elapsed);
+
+      sound_hash = headless_hash_bytes(sound_hash, sound.samples, sound.frame_sample_count * SOUND_OUTPUT_BYTES_PER_SAMPLE);
+   }
+
+   struct timespec end;
+   clock_gettime(CLOCK_MONOTONIC, &end);
+   double seconds = HEADLESS_SECONDS_ELAPSED(start, end);
+
+#if DEVELOPMENT_BUILD
+   print_timers((u32)frame_count);
+#endif
+
+   printf("Played back %zu frames in %.3fs (%.3fms/frame).\n", frame_count, seconds,
+          (frame_count > 0) ? (1000.0 * seconds / frame_count) : 0.0);
+   printf("Sound hash: %016llx\n", (unsigned long long)sound_hash);
+   printf("Final frame hash: %016llx\n", (unsigned long long)headless_hash_bitmap(renderer->output));
+
+   platform_free_file(&recording);
+
+   return(0);
+}
+
+function int headless_verify(int argument_count, char **arguments)
+{
+   // NOTE(law): Usage: verify [--repeat <count>] <level.sok> <solution.lurd> ...
+   // Each level/solution pair is replayed and checked for legality and
+   // completion. The repeat count only exists to get stable throughput numbers.
+
+   u32 repeat_count = 1;
+   if(argument_count >= 2 && strcmp(arguments[0], "--repeat") == 0)
+   {
+      repeat_count = MAXIMUM(1, atoi(arguments[1]));
+      arguments += 2;
+      argument_count -= 2;
+   }
+
+   if(argument_count < 2 || (argument_count % 2) != 0)
+   {
+      fprintf(stderr, "usage: verify [--repeat <count>] <level.sok> <solution.lurd> ...\n");
+      return(1);
+   }
+
+   struct game_state *gs = headless_allocate(sizeof(struct game_state));
+   struct game_level *level = headless_allocate(sizeof(struct game_level));
+   if(!gs || !level)
+   {
+      return(1);
+   }
+
+   u32 failure_count = 0;
+   u64 total_move_count = 0;
+   double total_seconds = 0;
+
+   for(int index = 0; index < argument_count; index += 2)
+   {
+      char *level_path = arguments[index + 0];
+      char *solution_path = arguments[index + 1];
+
+      if(!load_level(gs, level, level_path))
+      {
+         fprintf(stderr, "ERROR: Failed to load level \"%s\".\n", level_path);
+         failure_count++;
+         continue;
+      }
+
+      struct platform_file solution = platform_load_file(solution_path);
+      if(!solution.memory)
+      {
+         fprintf(stderr, "ERROR: Failed to load solution \"%s\".\n", solution_path);
+         failure_count++;
+         continue;
+      }
+
+      struct solution_result result = {0};
+
+      struct timespec start;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for(u32 repeat_index = 0; repeat_index < repeat_count; ++repeat_index)
+      {
+         result = verify_solution(&level->map, (char *)solution.memory, solution.size);
+      }
+      struct timespec end;
+      clock_gettime(CLOCK_MONOTONIC, &end);
+
+      total_seconds += HEADLESS_SECONDS_ELAPSED(start, end);
+      total_move_count += (u64)result.move_count * repeat_count;
+
+      if(!result.is_valid)
+      {
+         printf("INVALID    %s: illegal step '%c' at index %zu\n", level->name,
+                solution.memory[result.failure_index], result.failure_index);
+         failure_count++;
+      }
+      else if(!result.is_complete)
+      {
+         printf("INCOMPLETE %s: %u moves, %u pushes\n", level->name, result.move_count, result.push_count);
+         failure_count++;
+      }
+      else
+      {
+         printf("OK         %s: %u moves, %u pushes\n", level->name, result.move_count, result.push_count);
+      }
+
+      platform_free_file(&solution);
+   }
+
+   if(total_seconds > 0)
+   {
+      printf("Replayed %llu moves in %.3fs (%.1fM moves/s).\n", (unsigned long long)total_move_count,
+             total_seconds, (double)total_move_count / total_seconds / 1e6);
+   }
+
+   return(failure_count > 0);
+}
+
+function int headless_replay(int argument_count, char **arguments)
+{
+   // NOTE(law): Usage: replay <level.sok> <solution.lurd> <output.replay>
+   // Convert a LURD solution into a keyframed replay file for seeking.
+
+   if(argument_count != 3)
+   {
+      fprintf(stderr, "usage: replay <level.sok> <solution.lurd> <output.replay>\n");
+      return(1);
+   }
+
+   char *level_path = arguments[0];
+   char *solution_path = arguments[1];
+   char *output_path = arguments[2];
+
+   struct game_state *gs = headless_allocate(sizeof(struct game_state));
+   struct game_level *level = headless_allocate(sizeof(struct game_level));
+   if(!gs || !level)
+   {
+      return(1);
+   }
+
+   if(!load_level(gs, level, level_path))
+   {
+      fprintf(stderr, "ERROR: Failed to load level \"%s\".\n", level_path);
+      return(1);
+   }
+
+   struct platform_file solution = platform_load_file(solution_path);
+   if(!solution.memory)
+   {
+      fprintf(stderr, "ERROR: Failed to load solution \"%s\".\n", solution_path);
+      return(1);
+   }
+
+   int result = 1;
+
+   size_t capacity = get_replay_size((u32)solution.size, REPLAY_KEYFRAME_INTERVAL);
+   void *memory = headless_allocate(capacity);
+   if(memory)
+   {
+      size_t size = write_replay(&level->map, (char *)solution.memory, solution.size, memory, capacity);
+      if(size == 0)
+      {
+         fprintf(stderr, "ERROR: Solution \"%s\" contains an illegal step.\n", solution_path);
+      }
+      else if(!platform_save_file(output_path, memory, size))
+      {
+         fprintf(stderr, "ERROR: Failed to write replay \"%s\".\n", output_path);
+      }
+      else
+      {
+         struct replay replay;
+         parse_replay(&replay, memory, size);
+
+         printf("Wrote %s: %u moves, %u keyframes, %zu bytes.\n", output_path,
+                replay.move_count, replay.keyframe_count, size);
+         result = 0;
+      }
+
+      headless_deallocate(memory);
+   }
+
+   platform_free_file(&solution);
+
+   return(result);
+}
+
+function void headless_print_map(struct tile_map_state *map)
+{
+   // NOTE(law): Print the occupied rows of the map using .sok characters.
+
+   for(u32 tiley = 0; tiley < SCREEN_TILE_COUNT_Y; ++tiley)
+   {
+      char line[SCREEN_TILE_COUNT_X + 1];
+      u32 length = 0;
+
+      for(u32 tilex = 0; tilex < SCREEN_TILE_COUNT_X; ++tilex)
+      {
+         char c = ' ';
+         switch(map->tiles[tiley][tilex])
+         {
+            case TILE_TYPE_PLAYER:         {c = '@';} break;
+            case TILE_TYPE_PLAYER_ON_GOAL: {c = '+';} break;
+            case TILE_TYPE_BOX:            {c = '$';} break;
+            case TILE_TYPE_BOX_ON_GOAL:    {c = '*';} break;
+            case TILE_TYPE_WALL:           {c = '#';} break;
+            case TILE_TYPE_GOAL:           {c = '.';} break;
+            default: break;
+         }
+
+         line[tilex] = c;
+         if(c != ' ')
+         {
+            length = tilex + 1;
+         }
+      }
+
+      if(length > 0)
+      {
+         line[length] = 0;
+         printf("%s\n", line);
+      }
+   }
+}
+
+function int headless_seek(int argument_count, char **arguments)
+{
+   // NOTE(law): Usage: seek <file.replay> <move> ...
+   // Print the board after each requested move. Seeking starts from the nearest
+   // keyframe, so its cost does not depend on the length of the replay.
+
+   if(argument_count < 2)
+   {
+      fprintf(stderr, "usage: seek <file.replay> <move> ...\n");
+      return(1);
+   }
+
+   char *replay_path = arguments[0];
+
+   struct platform_file file = platform_load_file(replay_path);
+   if(!file.memory)
+   {
+      fprintf(stderr, "ERROR: Failed to load replay \"%s\".\n", replay_path);
+      return(1);
+   }
+
+   int result = 0;
+
+   struct replay replay;
+   if(!parse_replay(&replay, file.memory, file.size))
+   {
+      fprintf(stderr, "ERROR: \"%s\" is not a valid replay.\n", replay_path);
+      result = 1;
+   }
+   else
+   {
+      for(int index = 1; index < argument_count; ++index)
+      {
+         u32 move_index = (u32)strtoul(arguments[index], 0, 10);
+
+         struct tile_map_state map;
+         u32 push_count = 0;
+
+         struct timespec start;
+         clock_gettime(CLOCK_MONOTONIC, &start);
+         bool is_valid = seek_replay(&replay, move_index, &map, &push_count);
+         struct timespec end;
+         clock_gettime(CLOCK_MONOTONIC, &end);
+
+         if(!is_valid)
+         {
+            fprintf(stderr, "ERROR: Replay \"%s\" is corrupt before move %u.\n", replay_path, move_index);
+            result = 1;
+            break;
+         }
+
+         move_index = MINIMUM(move_index, replay.move_count);
+         printf("Move %u of %u, %u pushes (%.1fus):\n", move_index, replay.move_count, push_count,
+                1e6 * HEADLESS_SECONDS_ELAPSED(start, end));
+         headless_print_map(&map);
+      }
+   }
+
+   platform_free_file(&file);
+
+   return(result);
+}
+
+struct headless_benchmark_case
+{
+   char *label;
+   enum render_queue_entry_type type;
+   struct render_bitmap bitmap;
+   float offset;
+   s32 width;
+   s32 height;
+   float alpha_modulation;
+   u32 color;
+};
+
+function u32 headless_check_blending(struct game_renderer *renderer, struct memory_arena *arena)
+{
+   // NOTE(law): Compare the renderer's bitmap and screen kernels against the
+   // scalar software_blend and software_modulate references. Each pass fixes
+   // the source alpha and modulation, and lays out every pair of source and
+   // destination channel values across a 256x256 area. Fully opaque sources are
+   // also drawn tagged as opaque, and again as masked with half their pixels
+   // cleared, so that the copy and select paths are checked too. Returns the
+   // number of mismatched pixels.
+
+   u32 result = 0;
+
+   size_t watermark = arena->used;
+
+   s32 dimension = 256;
+   struct render_bitmap source = {dimension + 2, dimension + 2, dimension + 2};
+   source.memory = ALLOCATE_SIZE(arena, source.pitch * source.height * sizeof(u32));
+
+   struct render_bitmap screen_source = allocate_render_bitmap(arena, dimension, dimension);
+   struct render_bitmap destination = allocate_render_bitmap(arena, dimension, dimension);
+
+   struct render_clip clip = {0, 0, dimension, dimension};
+
+   for(u32 alpha = 0; alpha < 256; ++alpha)
+   {
+      u32 modulation = 255 - alpha;
+      for(s32 y = 0; y < dimension; ++y)
+      {
+         for(s32 x = 0; x < dimension; ++x)
+         {
+            u32 color = (alpha << 24) | ((x ^ y) << 16) | (y << 8) | x;
+            source.memory[((y + 1) * source.pitch) + (x + 1)] = color;
+            screen_source.memory[(y * screen_source.pitch) + x] = color;
+         }
+      }
+
+      u32 pass_count = (alpha == 255) ? 3 : 2;
+      for(u32 pass = 0; pass < pass_count; ++pass)
+      {
+         source.opacity = (alpha == 255) ? RENDER_BITMAP_OPAQUE : RENDER_BITMAP_TRANSLUCENT;
+         if(pass == 2)
+         {
+            source.opacity = RENDER_BITMAP_MASKED;
+            for(s32 y = 0; y < dimension; ++y)
+            {
+               for(s32 x = 0; x < dimension; ++x)
+               {
+                  if((x ^ (y >> 1)) & 1)
+                  {
+                     source.memory[((y + 1) * source.pitch) + (x + 1)] = 0;
+                     screen_source.memory[(y * screen_source.pitch) + x] = 0;
+                  }
+               }
+            }
+         }
+
+         for(s32 y = 0; y < dimension; ++y)
+         {
+            for(s32 x = 0; x < dimension; ++x)
+            {
+               destination.memory[(y * destination.pitch) + x] = (x << 24) | ((255 - y) << 16) | (x << 8) | y;
+            }
+         }
+
+         if(pass == 1)
+         {
+            renderer->screen(destination, clip, screen_source, (float)modulation / 255.0f);
+         }
+         else
+         {
+            renderer->bitmap(destination, clip, source, 0.0f, 0.0f, dimension, dimension);
+         }
+
+         for(s32 y = 0; y < dimension; ++y)
+         {
+            for(s32 x = 0; x < dimension; ++x)
+            {
+               u32 color = screen_source.memory[(y * screen_source.pitch) + x];
+               if(pass == 1)
+               {
+                  color = software_modulate(color, modulation);
+               }
+
+               u32 original = (x << 24) | ((255 - y) << 16) | (x << 8) | y;
+               u32 expected = software_blend(color, original);
+               if(destination.memory[(y * destination.pitch) + x] != expected)
+               {
+                  result++;
+               }
+            }
+         }
+      }
+   }
+
+   arena->used = watermark;
+
+   return(result);
+}
+
+function int headless_benchmark(int argument_count, char **arguments)
+{
+   // NOTE(law): Usage: benchmark [--iterations <count>]
+   // Check each kernel the CPU supports against the scalar blend reference, then
+   // time its bitmap, screen and clear functions on their own, single-threaded,
+   // drawing whole screens of tiles and glyphs, full screen fades and copies,
+   // and full screen clears, plus one clear large enough to take the streaming
+   // path. Final outputs are also checked against the 4-wide kernel's, and
+   // clears against their color. Reports timestamp counter cycles per pixel
+   // written.
+
+   u32 iteration_count = 200;
+   if(argument_count == 2 && strcmp(arguments[0], "--iterations") == 0)
+   {
+      iteration_count = MAXIMUM(1, atoi(arguments[1]));
+   }
+   else if(argument_count != 0)
+   {
+      fprintf(stderr, "usage: benchmark [--iterations <count>]\n");
+      return(1);
+   }
+
+   struct memory_arena arena = {0};
+   arena.size = 64 * 1024 * 1024;
+   arena.base_address = headless_allocate(arena.size);
+
+   struct render_bitmap output = {0};
+   output.width = RESOLUTION_BASE_WIDTH;
+   output.height = RESOLUTION_BASE_HEIGHT;
+   output.pitch = RENDER_BITMAP_PITCH(RESOLUTION_BASE_WIDTH);
+   output.memory = headless_allocate(output.pitch * output.height * sizeof(u32));
+
+   if(!arena.base_address || !output.memory)
+   {
+      return(1);
+   }
+
+   struct font_glyphs font = {0};
+   load_font(&font, &arena, "../data/atari.font");
+   struct render_bitmap glyph = font.glyphs['A'];
+   struct render_bitmap tile = load_bitmap(&arena, "../data/artwork/box.bmp");
+
+   // NOTE(law): Stand in for the level transition snapshot with opaque noise.
+   struct render_bitmap snapshot = output;
+   snapshot.opacity = RENDER_BITMAP_OPAQUE;
+   snapshot.memory = headless_allocate(snapshot.pitch * snapshot.height * sizeof(u32));
+   if(!snapshot.memory)
+   {
+      return(1);
+   }
+
+   // NOTE(law): A bitmap past SOFTWARE_STREAMING_CLEAR_PIXELS, so that the
+   // streaming clear is exercised even though no output is that large.
+   struct render_bitmap large = {0};
+   large.width = 2048;
+   large.height = 1024;
+   large.pitch = RENDER_BITMAP_PITCH(large.width);
+   large.memory = headless_allocate(large.pitch * large.height * sizeof(u32));
+   if(!large.memory)
+   {
+      return(1);
+   }
+   assert(large.width * large.height >= SOFTWARE_STREAMING_CLEAR_PIXELS);
+
+   struct random_entropy entropy = random_seed(0x5EED);
+   for(s32 index = 0; index < snapshot.pitch * snapshot.height; ++index)
+   {
+      snapshot.memory[index] = 0xFF000000 | (u32)random_value(&entropy);
+   }
+
+   enum render_queue_entry_type bitmap = RENDER_QUEUE_ENTRY_TYPE_BITMAP;
+   enum render_queue_entry_type screen = RENDER_QUEUE_ENTRY_TYPE_SCREEN;
+   enum render_queue_entry_type clear = RENDER_QUEUE_ENTRY_TYPE_CLEAR;
+
+   struct headless_benchmark_case cases[] =
+   {
+      {"tiles, aligned",   bitmap, tile,     0.0f, TILE_DIMENSION_PIXELS, TILE_DIMENSION_PIXELS},
+      {"tiles, unaligned", bitmap, tile,     0.5f, TILE_DIMENSION_PIXELS, TILE_DIMENSION_PIXELS},
+      {"glyphs",           bitmap, glyph,    0.0f, (glyph.width - 2) * TILE_BITMAP_SCALE, (glyph.height - 2) * TILE_BITMAP_SCALE},
+      {"screen fade",      screen, snapshot, 0.0f, output.width, output.height, 0.6f},
+      {"screen copy",      screen, snapshot, 0.0f, output.width, output.height, 1.0f},
+      {"clear",            clear,  output,   0.0f, output.width, output.height, 0.0f, 0xFF222034},
+      {"clear, streamed",  clear,  large,    0.0f, large.width,  large.height,  0.0f, 0xFF222034},
+   };
+
+   int result = 0;
+   for(enum software_kernel kernel = 0; kernel < SOFTWARE_KERNEL_COUNT; ++kernel)
+   {
+      if(is_software_kernel_supported(kernel))
+      {
+         struct game_renderer renderer = {0};
+         set_software_kernel(&renderer, kernel);
+
+         u32 mismatch_count = headless_check_blending(&renderer, &arena);
+         if(mismatch_count > 0)
+         {
+            result = 1;
+         }
+
+         printf("%-18s %-8s %u mismatched pixels\n", "blend reference", software_kernel_names[kernel], mismatch_count);
+      }
+   }
+
+   for(u32 case_index = 0; case_index < ARRAY_LENGTH(cases); ++case_index)
+   {
+      struct headless_benchmark_case *c = cases + case_index;
+
+      u64 expected_hash = 0;
+      for(enum software_kernel kernel = 0; kernel < SOFTWARE_KERNEL_COUNT; ++kernel)
+      {
+         if(!is_software_kernel_supported(kernel))
+         {
+            continue;
+         }
+
+         struct game_renderer renderer = {0};
+         set_software_kernel(&renderer, kernel);
+
+         // NOTE(law): Clears draw into their own bitmap, everything else into
+         // the output.
+         struct render_bitmap destination = (c->type == RENDER_QUEUE_ENTRY_TYPE_CLEAR) ? c->bitmap : output;
+         struct render_clip clip = {0, 0, destination.width, destination.height};
+         memset(destination.memory, 0, destination.pitch * destination.height * sizeof(u32));
+
+         u64 pixel_count = 0;
+         u64 cycles = 0;
+         struct timespec start;
+         clock_gettime(CLOCK_MONOTONIC, &start);
+
+         for(u32 iteration = 0; iteration < iteration_count; ++iteration)
+         {
+            if(c->type == RENDER_QUEUE_ENTRY_TYPE_CLEAR)
+            {
+               pixel_count += destination.width * destination.height;
+
+               u64 cycles_start = headless_read_cycle_counter();
+               renderer.clear(destination, clip, c->color);
+               cycles += headless_read_cycle_counter() - cycles_start;
+               continue;
+            }
+
+            if(c->type == RENDER_QUEUE_ENTRY_TYPE_SCREEN)
+            {
+               pixel_count += output.width * output.height;
+
+               u64 cycles_start = headless_read_cycle_counter();
+               renderer.screen(output, clip, c->bitmap, c->alpha_modulation);
+               cycles += headless_read_cycle_counter() - cycles_start;
+               continue;
+            }
+
+            for(s32 y = 0; y + c->height < output.height; y += c->height)
+            {
+               for(s32 x = 0; x + c->width < output.width; x += c->width)
+               {
+                  float posx = (float)x + c->offset;
+                  float posy = (float)y + c->offset;
+
+                  s32 minx = floor_s32(posx);
+                  s32 miny = floor_s32(posy);
+                  s32 maxx = ceiling_s32(posx + (float)(c->width - 1));
+                  s32 maxy = ceiling_s32(posy + (float)(c->height - 1));
+                  pixel_count += (maxx - minx + 1) * (maxy - miny + 1);
+
+                  u64 cycles_start = headless_read_cycle_counter();
+                  renderer.bitmap(output, clip, c->bitmap, posx, posy, c->width, c->height);
+                  cycles += headless_read_cycle_counter() - cycles_start;
+               }
+            }
+         }
+
+         struct timespec end;
+         clock_gettime(CLOCK_MONOTONIC, &end);
+         double seconds = HEADLESS_SECONDS_ELAPSED(start, end);
+
+         u64 hash = headless_hash_bitmap(destination);
+         if(kernel == SOFTWARE_KERNEL_4X)
+         {
+            expected_hash = hash;
+         }
+
+         bool is_match = (hash == expected_hash);
+         if(c->type == RENDER_QUEUE_ENTRY_TYPE_CLEAR)
+         {
+            for(s32 y = 0; y < destination.height; ++y)
+            {
+               for(s32 x = 0; x < destination.width; ++x)
+               {
+                  is_match = is_match && (destination.memory[(y * destination.pitch) + x] == c->color);
+               }
+            }
+         }
+         if(!is_match)
+         {
+            result = 1;
+         }
+
+         printf("%-18s %-8s %8.2f cycles/pixel %8.3f ns/pixel%s\n", c->label, software_kernel_names[kernel],
+                (double)cycles / (double)pixel_count, 1e9 * seconds / (double)pixel_count,
+                (is_match) ? "" : " (OUTPUT MISMATCH)");
+      }
+   }
+
+   return(result);
+}
+
+struct headless_thumbnail_job
+{
+   struct game_state *assets;
+   struct game_renderer *renderer_template;
+
+   char **level_paths;
+   u32 level_count;
+   u32 first_index;
+   u32 index_stride;
+
+   char *output_directory;
+   s32 downscale;
+
+   u32 written_count;
+   u32 failed_count;
+};
+
+function bool headless_write_ppm(char *file_path, struct render_bitmap bitmap, u8 *buffer)
+{
+   // NOTE(law): Write bitmap as a binary PPM, using buffer (at least 32 bytes
+   // plus 3 per pixel) to build the file in memory.
+   int header_size = sprintf((char *)buffer, "P6\n%d %d\n255\n", bitmap.width, bitmap.height);
+
+   u8 *rgb = buffer + header_size;
+   for(s32 y = 0; y < bitmap.height; ++y)
+   {
+      u32 *row = bitmap.memory + (y * bitmap.pitch);
+      for(s32 x = 0; x < bitmap.width; ++x)
+      {
+         u32 pixel = row[x];
+         *rgb++ = (u8)(pixel >> 16);
+         *rgb++ = (u8)(pixel >> 8);
+         *rgb++ = (u8)(pixel >> 0);
+      }
+   }
+
+   bool result = platform_save_file(file_path, buffer, rgb - buffer);
+   return(result);
+}
+
+#define HEADLESS_MAX_DOWNSCALE 16
+
+function void headless_downscale(struct render_bitmap destination, struct render_bitmap source, s32 factor,
+                                 struct render_clip clip)
+{
+   // NOTE(law): Box filter each factor x factor block of source that overlaps
+   // clip into one pixel of destination, rounding each channel to nearest.
+   // Alternate channels are summed in the 16-bit halves of two accumulators,
+   // which can't overflow for factors up to HEADLESS_MAX_DOWNSCALE.
+   assert(factor <= HEADLESS_MAX_DOWNSCALE);
+
+   s32 minx = clip.minx / factor;
+   s32 miny = clip.miny / factor;
+   s32 maxx = MINIMUM((clip.maxx + factor - 1) / factor, destination.width);
+   s32 maxy = MINIMUM((clip.maxy + factor - 1) / factor, destination.height);
+
+   u32 count = factor * factor;
+   for(s32 y = miny; y < maxy; ++y)
+   {
+      for(s32 x = minx; x < maxx; ++x)
+      {
+         u32 red_blue = 0;
+         u32 alpha_green = 0;
+         for(s32 sourcey = y * factor; sourcey < (y + 1) * factor; ++sourcey)
+         {
+            u32 *row = source.memory + (sourcey * source.pitch) + (x * factor);
+            for(s32 sourcex = 0; sourcex < factor; ++sourcex)
+            {
+               u32 pixel = row[sourcex];
+               red_blue += pixel & 0x00FF00FF;
+               alpha_green += (pixel >> 8) & 0x00FF00FF;
+            }
+         }
+
+         u32 blue  = ((red_blue & 0xFFFF) + (count / 2)) / count;
+         u32 red   = ((red_blue >> 16) + (count / 2)) / count;
+         u32 green = ((alpha_green & 0xFFFF) + (count / 2)) / count;
+         u32 alpha = ((alpha_green >> 16) + (count / 2)) / count;
+
+         destination.memory[(y * destination.pitch) + x] = (alpha << 24) | (red << 16) | (green << 8) | blue;
+      }
+   }
+}
+
+function u32 headless_count_job_levels(struct headless_thumbnail_job *job)
+{
+   u32 result = 0;
+   if(job->first_index < job->level_count)
+   {
+      result = (job->level_count - job->first_index + job->index_stride - 1) / job->index_stride;
+   }
+
+   return(result);
+}
+
+function PLATFORM_QUEUE_CALLBACK(headless_thumbnail_callback)
+{
+   // NOTE(law): Each job renders every index_stride'th level on its own thread,
+   // with a private copy of the game state that shares the loaded art. Its
+   // render tiles go through a work queue with no threads, so they run here
+   // instead of competing with the other jobs. Consecutive levels reuse the
+   // cached background, and only the tiles that differ are rasterized again.
+   struct headless_thumbnail_job *job = (struct headless_thumbnail_job *)data;
+
+   struct game_state *gs = headless_allocate(sizeof(struct game_state));
+   struct game_renderer *renderer = headless_allocate(sizeof(struct game_renderer));
+   struct game_level *level = headless_allocate(sizeof(struct game_level));
+   if(!gs || !renderer || !level)
+   {
+      fprintf(stderr, "ERROR: Failed to allocate memory for thumbnails.\n");
+      job->failed_count += headless_count_job_levels(job);
+
+      headless_deallocate(level);
+      headless_deallocate(renderer);
+      headless_deallocate(gs);
+      return;
+   }
+
+   // NOTE(law): The arena is shared with the other jobs, so leave this copy
+   // without one.
+   *gs = *job->assets;
+   gs->arena = (struct memory_arena){0};
+   gs->levels[0] = level;
+   gs->level_count = 1;
+   gs->level_index = 0;
+
+   *renderer = *job->renderer_template;
+
+   struct render_bitmap output = renderer->output;
+   struct render_bitmap thumbnail = {0};
+   thumbnail.width = output.width / job->downscale;
+   thumbnail.height = output.height / job->downscale;
+   thumbnail.pitch = (job->downscale > 1) ? thumbnail.width : output.pitch;
+
+   size_t pixel_size = output.pitch * output.height * sizeof(u32);
+   size_t thumbnail_size = thumbnail.width * thumbnail.height * sizeof(u32);
+   size_t ppm_size = 32 + (thumbnail.width * thumbnail.height * 3);
+
+   gs->frame_arena.size = 4 * 1024 * 1024;
+   gs->frame_arena.used = 0;
+   gs->frame_arena.base_address = headless_allocate(gs->frame_arena.size);
+   gs->background.memory = headless_allocate(pixel_size);
+   renderer->output.memory = headless_allocate(pixel_size);
+   thumbnail.memory = (job->downscale > 1) ? headless_allocate(thumbnail_size) : renderer->output.memory;
+   u8 *ppm = headless_allocate(ppm_size);
+
+   bool is_allocated = (gs->frame_arena.base_address && gs->background.memory &&
+                        renderer->output.memory && thumbnail.memory && ppm);
+   if(!is_allocated)
+   {
+      fprintf(stderr, "ERROR: Failed to allocate memory for thumbnails.\n");
+      job->failed_count += headless_count_job_levels(job);
+   }
+
+   struct platform_work_queue serial_queue = {0};
+   sem_init(&serial_queue.semaphore, 0, 0);
+
+   for(u32 index = job->first_index; is_allocated && index < job->level_count; index += job->index_stride)
+   {
+      // NOTE(law): Reseed for each level so that its output doesn't depend on
+      // which job loaded it.
+      gs->entropy = random_seed(0x1234);
+
+      char *level_path = job->level_paths[index];
+      if(!load_level(gs, level, level_path))
+      {
+         fprintf(stderr, "ERROR: Failed to load level \"%s\".\n", level_path);
+         job->failed_count++;
+         continue;
+      }
+
+      gs->frame_arena.used = 0;
+      begin_render_frame(renderer, &gs->frame_arena);
+
+      render_push_background(gs, renderer, &serial_queue);
+
+      float playerx = (float)level->map.player_tilex * TILE_DIMENSION_PIXELS;
+      float playery = (float)level->map.player_tiley * TILE_DIMENSION_PIXELS;
+      render_push_tile(renderer->queue + RENDER_LAYER_FOREGROUND, gs->player, playerx, playery);
+
+      render(renderer, &serial_queue);
+
+      // NOTE(law): The output keeps the previous level's pixels outside the
+      // dirty rectangles, and so does the thumbnail.
+      if(job->downscale > 1)
+      {
+         for(u32 dirty_index = 0; dirty_index < renderer->dirty_count; ++dirty_index)
+         {
+            headless_downscale(thumbnail, renderer->output, job->downscale, renderer->dirty[dirty_index]);
+         }
+      }
+
+      // NOTE(law): Name the thumbnail after the level file, without the
+      // extension.
+      char output_path[512];
+      int name_length = (int)strlen(level->name);
+      char *extension = strrchr(level->name, '.');
+      if(extension)
+      {
+         name_length = (int)(extension - level->name);
+      }
+      snprintf(output_path, sizeof(output_path), "%s/%.*s.ppm", job->output_directory, name_length, level->name);
+
+      if(headless_write_ppm(output_path, thumbnail, ppm))
+      {
+         job->written_count++;
+      }
+      else
+      {
+         fprintf(stderr, "ERROR: Failed to write thumbnail \"%s\".\n", output_path);
+         job->failed_count++;
+      }
+   }
+
+   sem_destroy(&serial_queue.semaphore);
+
+   headless_deallocate(ppm);
+   if(job->downscale > 1)
+   {
+      headless_deallocate(thumbnail.memory);
+   }
+   headless_deallocate(renderer->output.memory);
+   headless_deallocate(gs->background.memory);
+   headless_deallocate(gs->frame_arena.base_address);
+   headless_deallocate(level);
+   headless_deallocate(renderer);
+   headless_deallocate(gs);
+}
+
+function int headless_thumbnails(int argument_count, char **arguments)
+{
+   // NOTE(law): Usage: thumbnails [--downscale <factor>] <output directory> <level.sok> ...
+   // Render the starting position of each level offscreen and write it to the
+   // output directory as a PPM, optionally shrunk by an integer factor. The
+   // levels are split between jobs on the work queue.
+
+   s32 downscale = 1;
+   if(argument_count >= 2 && strcmp(arguments[0], "--downscale") == 0)
+   {
+      downscale = atoi(arguments[1]);
+      arguments += 2;
+      argument_count -= 2;
+   }
+
+   if(argument_count < 2 || downscale < 1 || downscale > HEADLESS_MAX_DOWNSCALE)
+   {
+      fprintf(stderr, "usage: thumbnails [--downscale <factor>] <output directory> <level.sok> ...\n");
+      return(1);
+   }
+
+   char *output_directory = arguments[0];
+   char **level_paths = arguments + 1;
+   u32 level_count = argument_count - 1;
+
+   struct platform_work_queue queue = {0};
+   headless_start_worker_threads(&queue);
+
+   // NOTE(law): Load the art once. Every job gets a copy of this state.
+   struct game_state *assets = headless_allocate(sizeof(struct game_state));
+   if(!assets)
+   {
+      return(1);
+   }
+
+   assets->arena.size = 64 * 1024 * 1024;
+   assets->arena.base_address = headless_allocate(assets->arena.size);
+   if(!assets->arena.base_address)
+   {
+      return(1);
+   }
+
+   assets->entropy = random_seed(0x1234);
+   load_artwork(assets);
+
+   assets->background.width = RESOLUTION_BASE_WIDTH;
+   assets->background.height = RESOLUTION_BASE_HEIGHT;
+   assets->background.pitch = RENDER_BITMAP_PITCH(RESOLUTION_BASE_WIDTH);
+   assets->background.opacity = RENDER_BITMAP_OPAQUE;
+
+   struct game_renderer renderer_template = {0};
+   initialize_software_renderer(&renderer_template);
+   renderer_template.output.width = RESOLUTION_BASE_WIDTH;
+   renderer_template.output.height = RESOLUTION_BASE_HEIGHT;
+   renderer_template.output.pitch = RENDER_BITMAP_PITCH(RESOLUTION_BASE_WIDTH);
+
+   struct headless_thumbnail_job jobs[HEADLESS_WORKER_THREAD_COUNT];
+   u32 job_count = MINIMUM(MINIMUM(headless_get_processor_count(), ARRAY_LENGTH(jobs)), level_count);
+
+   struct timespec start;
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   for(u32 job_index = 0; job_index < job_count; ++job_index)
+   {
+      struct headless_thumbnail_job *job = jobs + job_index;
+      zero_memory(job, sizeof(*job));
+
+      job->assets = assets;
+      job->renderer_template = &renderer_template;
+      job->level_paths = level_paths;
+      job->level_count = level_count;
+      job->first_index = job_index;
+      job->index_stride = job_count;
+      job->output_directory = output_directory;
+      job->downscale = downscale;
+
+      platform_enqueue_work(&queue, job, headless_thumbnail_callback);
+   }
+   platform_complete_queue(&queue);
+
+   struct timespec end;
+   clock_gettime(CLOCK_MONOTONIC, &end);
+   double seconds = HEADLESS_SECONDS_ELAPSED(start, end);
+
+   u32 written_count = 0;
+   u32 failed_count = 0;
+   for(u32 job_index = 0; job_index < job_count; ++job_index)
+   {
+      written_count += jobs[job_index].written_count;
+      failed_count += jobs[job_index].failed_count;
+   }
+
+   printf("Wrote %u thumbnails (%dx%d) in %.3fs (%.0f/s) with %u jobs.\n", written_count,
+          RESOLUTION_BASE_WIDTH / downscale, RESOLUTION_BASE_HEIGHT / downscale, seconds,
+          (seconds > 0) ? (double)written_count / seconds : 0.0, job_count);
+
+   return(failed_count > 0);
+}
+
+function void headless_print_usage(void)
+{
+   fprintf(stderr, "usage: sokoban_headless <command> [arguments]\n\n");
+   fprintf(stderr, "commands:\n");
+   fprintf(stderr, "   verify [--repeat <count>] <level.sok> <solution.lurd> ...\n");
+   fprintf(stderr, "   playback <recording>\n");
+   fprintf(stderr, "   replay <level.sok> <solution.lurd> <output.replay>\n");
+   fprintf(stderr, "   seek <file.replay> <move> ...\n");
+   fprintf(stderr, "   benchmark [--iterations <count>]\n");
+   fprintf(stderr, "   thumbnails [--downscale <factor>] <output directory> <level.sok> ...\n");
+}
+
+int main(int argument_count, char **arguments)
+{
+   if(argument_count < 2)
+   {
+      headless_print_usage();
+      return(1);
+   }
+
+   char *command = arguments[1];
+   argument_count -= 2;
+   arguments += 2;
+
+   int result = 1;
+   if(strcmp(command, "verify") == 0)
+   {
+      result = headless_verify(argument_count, arguments);
+   }
+   else if(strcmp(command, "playback") == 0)
+   {
+      result = headless_playback(argument_count, arguments);
+   }
+   else if(strcmp(command, "replay") == 0)
+   {
+      result = headless_replay(argument_count, arguments);
+   }
+   else if(strcmp(command, "seek") == 0)
+   {
+      result = headless_seek(argument_count, arguments);
+   }
+   else if(strcmp(command, "benchmark") == 0)
+   {
+      result = headless_benchmark(argument_count, arguments);
+   }
+   else if(strcmp(command, "thumbnails") == 0)
+   {
+      result = headless_thumbnails(argument_count, arguments);
+   }
+   else
+   {
+      headless_print_usage();
+   }
+
+   return(result);
+}
@@ -2,32 +2,68 @@
 /* (c) copyright 2023 Lawrence D. Kern /////////////////////////////////////// */
 /* /////////////////////////////////////////////////////////////////////////// */
 
+// NOTE(law): u16_8x_div255 computes x / 255 rounded to nearest, exactly, for
+// any x up to 255 * 255. The NEON and SSE versions use different tricks but
+// agree on every such input. u16_8x_broadcast3 copies lane 3 of each group of
+// four lanes (the alpha of an unpacked pixel) to the whole group.
+// u32_4x_select takes bits from a where mask is set, and from b elsewhere.
+// u32_4x_load, u32_4x_store and u32_4x_stream need 16-byte aligned addresses.
+// Streaming stores bypass the cache where the CPU supports it, and are only
+// ordered with other stores after a stream_fence.
+
 #if __ARM_NEON
 #   include <arm_neon.h>
 
 typedef float32x4_t f32_4x;
 typedef uint32x4_t u32_4x;
+typedef uint16x8_t u16_8x;
 
-#   define u32_4x_set1(v) {(v), (v), (v), (v)}
+#   define u32_4x_set1(v) vdupq_n_u32(v)
 #   define u32_4x_and(a, b) vandq_u32((a), (b))
 #   define u32_4x_or(a, b) vorrq_u32((a), (b))
 #   define u32_4x_slli(v, n) vshlq_n_u32((v), (n))
 #   define u32_4x_srli(v, n) vshrq_n_u32((v), (n))
 #   define u32_4x_loadu(p) vld1q_u32((u32 *)(p))
 #   define u32_4x_storeu(p, v) vst1q_u32((u32 *)(p), (v))
+#   define u32_4x_load(p) vld1q_u32((u32 *)(p))
+#   define u32_4x_store(p, v) vst1q_u32((u32 *)(p), (v))
+#   define u32_4x_stream(p, v) vst1q_u32((u32 *)(p), (v))
+#   define stream_fence()
 #   define u32_4x_convert_f32_4x(v) vcvtq_u32_f32(v)
+#   define u32_4x_truncate_f32_4x(v) vcvtq_u32_f32(v)
+#   define u32_4x_pack_u16_8x(lo, hi) vreinterpretq_u32_u8(vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)))
+#   define u32_4x_srai(v, n) vreinterpretq_u32_s32(vshrq_n_s32(vreinterpretq_s32_u32(v), (n)))
+#   define u32_4x_select(mask, a, b) vbslq_u32((mask), (a), (b))
+
+#   define u16_8x_set1(v) vdupq_n_u16(v)
+#   define u16_8x_add(a, b) vaddq_u16((a), (b))
+#   define u16_8x_sub(a, b) vsubq_u16((a), (b))
+#   define u16_8x_mul(a, b) vmulq_u16((a), (b))
+#   define u16_8x_unpacklo_u32_4x(v) vmovl_u8(vget_low_u8(vreinterpretq_u8_u32(v)))
+#   define u16_8x_unpackhi_u32_4x(v) vmovl_u8(vget_high_u8(vreinterpretq_u8_u32(v)))
+#   define u16_8x_broadcast3(v) vcombine_u16(vdup_lane_u16(vget_low_u16(v), 3), vdup_lane_u16(vget_high_u16(v), 3))
+#   define u16_8x_div255(v) vshrq_n_u16(vsraq_n_u16(vaddq_u16((v), vdupq_n_u16(128)), vaddq_u16((v), vdupq_n_u16(128)), 8), 8)
 
-#   define f32_4x_set1(v) {(v), (v), (v), (v)}
+#   define f32_4x_set1(v) vdupq_n_f32(v)
+#   define f32_4x_set(a, b, c, d) ((f32_4x){(a), (b), (c), (d)})
+#   define f32_4x_loadu(p) vld1q_f32((float *)(p))
 #   define f32_4x_add(a, b) vaddq_f32((a), (b))
 #   define f32_4x_sub(a, b) vsubq_f32((a), (b))
 #   define f32_4x_mul(a, b) vmulq_f32((a), (b))
+#   define f32_4x_div(a, b) vdivq_f32((a), (b))
+#   define f32_4x_min(a, b) vminq_f32((a), (b))
+#   define f32_4x_max(a, b) vmaxq_f32((a), (b))
 #   define f32_4x_convert_u32_4x(v) vcvtq_f32_u32(v)
 
 #else
 #   include <immintrin.h>
+#   if _MSC_VER
+#      include <intrin.h>
+#   endif
 
 typedef __m128 f32_4x;
 typedef __m128i u32_4x;
+typedef __m128i u16_8x;
 
 #   define u32_4x_set1(v) _mm_set1_epi32(v)
 #   define u32_4x_and(a, b) _mm_and_si128((a), (b))
@@ -36,11 +72,33 @@ typedef __m128i u32_4x;
 #   define u32_4x_srli(v, n) _mm_srli_epi32((v), (n))
 #   define u32_4x_loadu(p) _mm_loadu_si128((u32_4x *)(p))
 #   define u32_4x_storeu(p, v) _mm_storeu_si128((u32_4x *)(p), (v))
+#   define u32_4x_load(p) _mm_load_si128((u32_4x *)(p))
+#   define u32_4x_store(p, v) _mm_store_si128((u32_4x *)(p), (v))
+#   define u32_4x_stream(p, v) _mm_stream_si128((u32_4x *)(p), (v))
+#   define stream_fence() _mm_sfence()
 #   define u32_4x_convert_f32_4x(v) _mm_cvtps_epi32(v)
+#   define u32_4x_truncate_f32_4x(v) _mm_cvttps_epi32(v)
+#   define u32_4x_pack_u16_8x(lo, hi) _mm_packus_epi16((lo), (hi))
+#   define u32_4x_srai(v, n) _mm_srai_epi32((v), (n))
+#   define u32_4x_select(mask, a, b) _mm_or_si128(_mm_and_si128((mask), (a)), _mm_andnot_si128((mask), (b)))
+
+#   define u16_8x_set1(v) _mm_set1_epi16((short)(v))
+#   define u16_8x_add(a, b) _mm_add_epi16((a), (b))
+#   define u16_8x_sub(a, b) _mm_sub_epi16((a), (b))
+#   define u16_8x_mul(a, b) _mm_mullo_epi16((a), (b))
+#   define u16_8x_unpacklo_u32_4x(v) _mm_unpacklo_epi8((v), _mm_setzero_si128())
+#   define u16_8x_unpackhi_u32_4x(v) _mm_unpackhi_epi8((v), _mm_setzero_si128())
+#   define u16_8x_broadcast3(v) _mm_shufflehi_epi16(_mm_shufflelo_epi16((v), 0xFF), 0xFF)
+#   define u16_8x_div255(v) _mm_srli_epi16(_mm_mulhi_epu16(_mm_add_epi16((v), _mm_set1_epi16(127)), _mm_set1_epi16((short)0x8081)), 7)
 
 #   define f32_4x_set1(v) _mm_set1_ps(v)
+#   define f32_4x_set(a, b, c, d) _mm_setr_ps((a), (b), (c), (d))
+#   define f32_4x_loadu(p) _mm_loadu_ps((float *)(p))
 #   define f32_4x_add(a, b) _mm_add_ps((a), (b))
 #   define f32_4x_sub(a, b) _mm_sub_ps((a), (b))
 #   define f32_4x_mul(a, b) _mm_mul_ps((a), (b))
+#   define f32_4x_div(a, b) _mm_div_ps((a), (b))
+#   define f32_4x_min(a, b) _mm_min_ps((a), (b))
+#   define f32_4x_max(a, b) _mm_max_ps((a), (b))
 #   define f32_4x_convert_u32_4x(v) _mm_cvtepi32_ps(v)
 #endif
@@ -19,11 +19,13 @@
 
 #include <errno.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 
 typedef sem_t platform_semaphore;
 #include "platform.h"
 #include "sokoban.c"
+#include "renderer_software.c"
 
 #define LINUX_WORKER_THREAD_COUNT 8
 #define LINUX_LOG_MAX_LENGTH 1024
@@ -38,15 +40,15 @@ global Display *linux_global_display;
 #if DEVELOPMENT_BUILD
 function PLATFORM_TIMER_BEGIN(platform_timer_begin)
 {
-   global_platform_timers[id].id = id;
-   global_platform_timers[id].label = label;
-   global_platform_timers[id].start = __rdtsc();
+   global_platform_profiler.timers[id].id = id;
+   global_platform_profiler.timers[id].label = label;
+   global_platform_profiler.timers[id].start = __rdtsc();
 }
 
 function PLATFORM_TIMER_END(platform_timer_end)
 {
-   global_platform_timers[id].elapsed += (__rdtsc() - global_platform_timers[id].start);
-   global_platform_timers[id].hits++;
+   global_platform_profiler.timers[id].elapsed += (__rdtsc() - global_platform_profiler.timers[id].start);
+   global_platform_profiler.timers[id].hits++;
 }
 #endif
 
@@ -72,9 +74,11 @@ function void *linux_allocate(size_t size)
 {
    // NOTE(law): munmap() requires the size of the allocation in order to free
    // the virtual memory. This function smuggles the allocation size just before
-   // the address that it actually returns.
+   // the address that it actually returns. The header is padded out to
+   // RENDER_BITMAP_ALIGNMENT, so the result keeps that much of mmap's page
+   // alignment.
 
-   size_t allocation_size = size + sizeof(size_t);
+   size_t allocation_size = size + RENDER_BITMAP_ALIGNMENT;
    void *allocation = mmap(0, allocation_size, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
 
    if(allocation == MAP_FAILED)
@@ -83,9 +87,9 @@ function void *linux_allocate(size_t size)
       return(0);
    }
 
-   *(size_t *)allocation = allocation_size;
+   void *result = (void *)((u8 *)allocation + RENDER_BITMAP_ALIGNMENT);
+   *((size_t *)result - 1) = allocation_size;
 
-   void *result = (void *)((u8 *)allocation + sizeof(size_t));
    return(result);
 }
 
@@ -95,8 +99,8 @@ function void linux_deallocate(void *memory)
    // the virtual memory. We always just want to dump the entire thing, so
    // allocate() hides the allocation size just before the address it returns.
 
-   void *allocation = (void *)((u8 *)memory - sizeof(size_t));
-   size_t allocation_size = *(size_t *)allocation;
+   void *allocation = (void *)((u8 *)memory - RENDER_BITMAP_ALIGNMENT);
+   size_t allocation_size = *((size_t *)memory - 1);
 
    if(munmap(allocation, allocation_size) != 0)
    {
@@ -178,6 +182,394 @@ function PLATFORM_SAVE_FILE(platform_save_file)
    return(result);
 }
 
+// NOTE(law): Queued saves are written by a dedicated thread, separate from the
+// work queue so that disk latency never stalls frame work. Requests wait until
+// none have arrived for LINUX_SAVE_COALESCE_SECONDS, so a burst of saves (e.g.
+// skipping through levels) only writes each file once. Appends are queued the
+// same way, so they land in order with any full writes of the same file. A
+// steady stream of requests never goes quiet, so nothing waits longer than
+// LINUX_SAVE_MAXIMUM_DELAY_SECONDS after the first request of a batch.
+
+#define LINUX_PENDING_SAVE_COUNT 8
+#define LINUX_SAVE_COALESCE_SECONDS 0.25
+#define LINUX_SAVE_MAXIMUM_DELAY_SECONDS 1.0
+
+struct linux_pending_save
+{
+   char file_path[256];
+   void *memory;
+   size_t size;
+   bool is_append;
+};
+
+struct linux_save_queue
+{
+   pthread_mutex_t mutex;
+   pthread_cond_t condition;
+
+   bool is_writing;
+   bool is_flushing;
+   bool is_synchronous;
+   struct timespec first_request;
+   struct timespec last_request;
+
+   u32 pending_count;
+   struct linux_pending_save pending[LINUX_PENDING_SAVE_COUNT];
+};
+
+global struct linux_save_queue linux_global_save_queue;
+
+function bool linux_write_and_sync(int file, void *memory, size_t size)
+{
+   u8 *bytes = (u8 *)memory;
+   size_t remaining = size;
+   while(remaining > 0)
+   {
+      ssize_t bytes_written = write(file, bytes, remaining);
+      if(bytes_written == -1 && errno == EINTR)
+      {
+         continue;
+      }
+      if(bytes_written <= 0)
+      {
+         break;
+      }
+
+      bytes += bytes_written;
+      remaining -= bytes_written;
+   }
+
+   bool result = (remaining == 0 && fsync(file) == 0);
+   return(result);
+}
+
+function bool linux_write_file_atomically(char *file_path, void *memory, size_t size)
+{
+   // NOTE(law): Write to a temporary file next to the destination, flush it,
+   // then rename it over the destination. A crash at any point leaves either
+   // the complete old file or the complete new one.
+
+   bool result = false;
+
+   char temporary_path[512];
+   int length = snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", file_path);
+   if(length < 0 || length >= (int)sizeof(temporary_path))
+   {
+      platform_log("ERROR: Linux save path is too long: \"%s\".\n", file_path);
+      return(result);
+   }
+
+   int file = open(temporary_path, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+   if(file == -1)
+   {
+      platform_log("ERROR (%d): Linux failed to open file: \"%s\".\n", errno, temporary_path);
+      return(result);
+   }
+
+   result = linux_write_and_sync(file, memory, size);
+   close(file);
+
+   if(result)
+   {
+      result = (rename(temporary_path, file_path) == 0);
+   }
+
+   if(result)
+   {
+      // NOTE(law): Flush the directory as well, so that the rename itself
+      // survives a crash.
+      char directory_path[512];
+      length = snprintf(directory_path, sizeof(directory_path), "%s", file_path);
+      assert(length >= 0 && length < (int)sizeof(directory_path));
+
+      char *separator = strrchr(directory_path, '/');
+      if(separator)
+      {
+         *separator = 0;
+      }
+      else
+      {
+         snprintf(directory_path, sizeof(directory_path), ".");
+      }
+
+      int directory = open(directory_path, O_RDONLY);
+      if(directory != -1)
+      {
+         fsync(directory);
+         close(directory);
+      }
+   }
+   else
+   {
+      platform_log("ERROR (%d): Linux failed to write file: \"%s\".\n", errno, file_path);
+      unlink(temporary_path);
+   }
+
+   return(result);
+}
+
+function bool linux_append_file(char *file_path, void *memory, size_t size)
+{
+   // NOTE(law): A crash can leave a partial append at the end of the file. The
+   // game is expected to detect and discard it when the file is next read.
+
+   bool result = false;
+
+   int file = open(file_path, O_WRONLY|O_CREAT|O_APPEND, 0666);
+   if(file == -1)
+   {
+      platform_log("ERROR (%d): Linux failed to open file: \"%s\".\n", errno, file_path);
+      return(result);
+   }
+
+   result = linux_write_and_sync(file, memory, size);
+   close(file);
+
+   if(!result)
+   {
+      platform_log("ERROR (%d): Linux failed to append to file: \"%s\".\n", errno, file_path);
+   }
+
+   return(result);
+}
+
+function void linux_queue_file(char *file_path, void *memory, size_t size, bool is_append)
+{
+   struct linux_save_queue *queue = &linux_global_save_queue;
+
+   if(queue->is_synchronous)
+   {
+      // NOTE(law): Without a save thread, nothing would ever drain the queue.
+      if(is_append)
+      {
+         linux_append_file(file_path, memory, size);
+      }
+      else
+      {
+         linux_write_file_atomically(file_path, memory, size);
+      }
+      return;
+   }
+
+   // NOTE(law): Copy the data before taking the lock, so that the lock is only
+   // ever held for bookkeeping.
+   void *copy = linux_allocate(size);
+   if(!copy)
+   {
+      return;
+   }
+   memcpy(copy, memory, size);
+
+   pthread_mutex_lock(&queue->mutex);
+
+   struct linux_pending_save *save = 0;
+   for(u32 index = 0; index < queue->pending_count; ++index)
+   {
+      if(strcmp(queue->pending[index].file_path, file_path) == 0)
+      {
+         save = queue->pending + index;
+         break;
+      }
+   }
+
+   if(save && is_append)
+   {
+      // NOTE(law): Tack the new bytes onto whatever is already pending for this
+      // file, keeping the pending write's mode. An append after a full write
+      // becomes part of that write.
+      void *combined = linux_allocate(save->size + size);
+      if(combined)
+      {
+         memcpy(combined, save->memory, save->size);
+         memcpy((u8 *)combined + save->size, copy, size);
+
+         linux_deallocate(save->memory);
+         linux_deallocate(copy);
+
+         save->memory = combined;
+         save->size += size;
+      }
+      else
+      {
+         platform_log("ERROR: Linux failed to combine queued writes, dropping append to \"%s\".\n", file_path);
+         linux_deallocate(copy);
+      }
+
+      clock_gettime(CLOCK_REALTIME, &queue->last_request);
+      pthread_cond_broadcast(&queue->condition);
+   }
+   else
+   {
+      if(save)
+      {
+         linux_deallocate(save->memory);
+      }
+      else if(queue->pending_count < ARRAY_LENGTH(queue->pending))
+      {
+         if(queue->pending_count == 0)
+         {
+            clock_gettime(CLOCK_REALTIME, &queue->first_request);
+         }
+
+         save = queue->pending + queue->pending_count++;
+         snprintf(save->file_path, sizeof(save->file_path), "%s", file_path);
+      }
+
+      if(save)
+      {
+         save->memory = copy;
+         save->size = size;
+         save->is_append = is_append;
+
+         clock_gettime(CLOCK_REALTIME, &queue->last_request);
+         pthread_cond_broadcast(&queue->condition);
+      }
+      else
+      {
+         platform_log("ERROR: Linux save queue is full, dropping \"%s\".\n", file_path);
+         linux_deallocate(copy);
+      }
+   }
+
+   pthread_mutex_unlock(&queue->mutex);
+}
+
+function PLATFORM_QUEUE_SAVE_FILE(platform_queue_save_file)
+{
+   linux_queue_file(file_path, memory, size, false);
+}
+
+function PLATFORM_QUEUE_APPEND_FILE(platform_queue_append_file)
+{
+   linux_queue_file(file_path, memory, size, true);
+}
+
+function struct timespec linux_offset_time(struct timespec time, double seconds)
+{
+   struct timespec result = time;
+   result.tv_nsec += (long)(seconds * 1e9);
+   result.tv_sec += result.tv_nsec / 1000000000;
+   result.tv_nsec %= 1000000000;
+
+   return(result);
+}
+
+function void *linux_save_thread_procedure(void *parameter)
+{
+   struct linux_save_queue *queue = (struct linux_save_queue *)parameter;
+
+   pthread_mutex_lock(&queue->mutex);
+   while(1)
+   {
+      if(queue->pending_count == 0)
+      {
+         pthread_cond_wait(&queue->condition, &queue->mutex);
+         continue;
+      }
+
+      if(!queue->is_flushing)
+      {
+         struct timespec deadline = linux_offset_time(queue->last_request, LINUX_SAVE_COALESCE_SECONDS);
+         struct timespec latest = linux_offset_time(queue->first_request, LINUX_SAVE_MAXIMUM_DELAY_SECONDS);
+         if(latest.tv_sec < deadline.tv_sec || (latest.tv_sec == deadline.tv_sec && latest.tv_nsec < deadline.tv_nsec))
+         {
+            deadline = latest;
+         }
+
+         struct timespec now;
+         clock_gettime(CLOCK_REALTIME, &now);
+         if(LINUX_SECONDS_ELAPSED(now, deadline) > 0)
+         {
+            pthread_cond_timedwait(&queue->condition, &queue->mutex, &deadline);
+            continue;
+         }
+      }
+
+      // NOTE(law): Take every pending save and write them without the lock held.
+      struct linux_pending_save saves[LINUX_PENDING_SAVE_COUNT];
+      u32 save_count = queue->pending_count;
+      memcpy(saves, queue->pending, save_count * sizeof(saves[0]));
+
+      queue->pending_count = 0;
+      queue->is_writing = true;
+      pthread_mutex_unlock(&queue->mutex);
+
+      for(u32 index = 0; index < save_count; ++index)
+      {
+         struct linux_pending_save *save = saves + index;
+         if(save->is_append)
+         {
+            linux_append_file(save->file_path, save->memory, save->size);
+         }
+         else
+         {
+            linux_write_file_atomically(save->file_path, save->memory, save->size);
+         }
+         linux_deallocate(save->memory);
+      }
+
+      pthread_mutex_lock(&queue->mutex);
+      queue->is_writing = false;
+      pthread_cond_broadcast(&queue->condition);
+   }
+
+   return(0);
+}
+
+function void linux_start_save_thread(struct linux_save_queue *queue)
+{
+   pthread_mutex_init(&queue->mutex, 0);
+   pthread_cond_init(&queue->condition, 0);
+
+   pthread_t id;
+   if(pthread_create(&id, 0, linux_save_thread_procedure, queue) != 0)
+   {
+      platform_log("ERROR: Linux failed to create the save thread, saves will be written synchronously.\n");
+      queue->is_synchronous = true;
+      return;
+   }
+
+   pthread_detach(id);
+}
+
+function void linux_complete_saves(struct linux_save_queue *queue)
+{
+   // NOTE(law): Block until every queued save is on disk.
+   pthread_mutex_lock(&queue->mutex);
+
+   queue->is_flushing = true;
+   pthread_cond_broadcast(&queue->condition);
+
+   while(queue->pending_count > 0 || queue->is_writing)
+   {
+      pthread_cond_wait(&queue->condition, &queue->mutex);
+   }
+
+   queue->is_flushing = false;
+   pthread_mutex_unlock(&queue->mutex);
+}
+
+function PLATFORM_FLUSH_FILE(platform_flush_file)
+{
+   // NOTE(law): The save thread doesn't track which files are in a write that
+   // is already under way, so any write in progress is waited on as well.
+   struct linux_save_queue *queue = &linux_global_save_queue;
+   pthread_mutex_lock(&queue->mutex);
+
+   bool is_pending = queue->is_writing;
+   for(u32 index = 0; !is_pending && index < queue->pending_count; ++index)
+   {
+      is_pending = (strcmp(queue->pending[index].file_path, file_path) == 0);
+   }
+
+   pthread_mutex_unlock(&queue->mutex);
+
+   if(is_pending)
+   {
+      linux_complete_saves(queue);
+   }
+}
+
 function PLATFORM_ENQUEUE_WORK(platform_enqueue_work)
 {
    u32 new_write_index = (queue->write_index + 1) % ARRAY_LENGTH(queue->entries);
@@ -303,12 +695,17 @@ function Window linux_create_window(struct render_bitmap bitmap, XVisualInfo *vi
                                    PropertyChangeMask);
    attribute_mask |= CWEventMask;
 
+   // NOTE(law): The window is sized for display, which is larger than the
+   // bitmap when the game renders at native resolution.
+   s32 display_width = bitmap.width * PRESENT_SCALE;
+   s32 display_height = bitmap.height * PRESENT_SCALE;
+
    Window window = XCreateWindow(display,
                                  root,
                                  0,
                                  0,
-                                 bitmap.width,
-                                 bitmap.height,
+                                 display_width,
+                                 display_height,
                                  0,
                                  visual_info->depth,
                                  InputOutput,
@@ -322,10 +719,10 @@ function Window linux_create_window(struct render_bitmap bitmap, XVisualInfo *vi
 
    XSizeHints size_hints = {0};
    size_hints.flags = PMinSize|PMaxSize;
-   size_hints.min_width = bitmap.width / 2;
-   size_hints.min_height = bitmap.height / 2;
-   size_hints.max_width = bitmap.width;
-   size_hints.max_height = bitmap.height;
+   size_hints.min_width = display_width / 2;
+   size_hints.min_height = display_height / 2;
+   size_hints.max_width = display_width;
+   size_hints.max_height = display_height;
    XSetWMNormalHints(display, window, &size_hints);
 
    XMapWindow(display, window);
@@ -402,6 +799,7 @@ typedef   void opengl_function_glBufferData(GLenum target, GLsizeiptr size, cons
 global GLuint opengl_global_vertex_buffer_object;
 global GLuint opengl_global_vertex_array_object;
 global GLuint opengl_global_shader_program;
+global bool opengl_global_is_texture_allocated;
 
 function Window linux_initialize_opengl(struct render_bitmap bitmap)
 {
@@ -595,7 +993,11 @@ function Window linux_initialize_opengl(struct render_bitmap bitmap)
    }
    assert(vertex_compilation_status == GL_TRUE);
 
-   // NOTE(law): Compile fragment shader.
+   // NOTE(law): Compile fragment shader. Each window pixel fetches the single
+   // texel it lands on, rather than relying on the sampler's rounding. When the
+   // viewport is a whole multiple of the bitmap, as it is at the default window
+   // size with RENDER_AT_NATIVE_RESOLUTION, every texel covers exactly that many
+   // pixels in each direction.
    const char *fragment_shader_code =
    "#version 330 core\n"
    "\n"
@@ -605,7 +1007,9 @@ function Window linux_initialize_opengl(struct render_bitmap bitmap)
    "\n"
    "void main()\n"
    "{\n"
-   "   output_color = texture(bitmap_texture, fragment_texture_coordinate);\n"
+   "   ivec2 size = textureSize(bitmap_texture, 0);\n"
+   "   ivec2 texel = ivec2(fragment_texture_coordinate * vec2(size));\n"
+   "   output_color = texelFetch(bitmap_texture, clamp(texel, ivec2(0), size - 1), 0);\n"
    "}\n";
 
    GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
@@ -665,7 +1069,7 @@ function Window linux_initialize_opengl(struct render_bitmap bitmap)
    return(window);
 }
 
-function void linux_display_bitmap(Window window, struct render_bitmap bitmap)
+function void linux_display_bitmap(Window window, struct render_bitmap bitmap, struct render_clip *dirty, u32 dirty_count)
 {
    struct linux_window_dimensions dimensions;
    linux_get_window_dimensions(window, &dimensions);
@@ -703,10 +1107,29 @@ function void linux_display_bitmap(Window window, struct render_bitmap bitmap)
    glClearColor(0, 0, 0, 1);
    glClear(GL_COLOR_BUFFER_BIT);
 
-   // NOTE(law): Set up the pixel bitmap as an OpenGL texture.
+   // NOTE(law): Set up the pixel bitmap as an OpenGL texture. After the first
+   // frame, the texture keeps its contents and only the regions the renderer
+   // redrew are uploaded.
    glBindTexture(GL_TEXTURE_2D, 1);
-   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, bitmap.width, bitmap.height, 0,
-                GL_BGRA_EXT, GL_UNSIGNED_BYTE, bitmap.memory);
+   glPixelStorei(GL_UNPACK_ROW_LENGTH, bitmap.pitch);
+   if(!opengl_global_is_texture_allocated)
+   {
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, bitmap.width, bitmap.height, 0,
+                   GL_BGRA_EXT, GL_UNSIGNED_BYTE, bitmap.memory);
+      opengl_global_is_texture_allocated = true;
+   }
+   else
+   {
+      for(u32 index = 0; index < dirty_count; ++index)
+      {
+         struct render_clip rect = dirty[index];
+         u32 *memory = bitmap.memory + (rect.miny * bitmap.pitch) + rect.minx;
+
+         glTexSubImage2D(GL_TEXTURE_2D, 0, rect.minx, rect.miny, rect.maxx - rect.minx, rect.maxy - rect.miny,
+                         GL_BGRA_EXT, GL_UNSIGNED_BYTE, memory);
+      }
+   }
+   glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -811,6 +1234,11 @@ function void linux_process_keyboard(Window window, XEvent event, struct game_in
          linux_set_key_state(&input->undo, key_is_pressed);
       } break;
 
+      case XK_y:
+      {
+         linux_set_key_state(&input->redo, key_is_pressed);
+      } break;
+
       case XK_r:
       {
          linux_set_key_state(&input->reload, key_is_pressed);
@@ -825,6 +1253,21 @@ function void linux_process_keyboard(Window window, XEvent event, struct game_in
       {
          linux_set_key_state(&input->previous, key_is_pressed);
       } break;
+
+      case XK_F1:
+      {
+         linux_set_key_state(&input->function_keys[1], key_is_pressed);
+      } break;
+
+      case XK_F2:
+      {
+         linux_set_key_state(&input->function_keys[2], key_is_pressed);
+      } break;
+
+      case XK_F3:
+      {
+         linux_set_key_state(&input->function_keys[3], key_is_pressed);
+      } break;
    }
 }
 
@@ -898,6 +1341,54 @@ function void linux_process_events(Window window, struct game_input *input)
    }
 }
 
+function int linux_begin_input_recording(char *file_path)
+{
+   // NOTE(law): Return the file descriptor that subsequent frames should be
+   // appended to, or -1 if recording couldn't be started.
+
+   int result = open(file_path, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+   if(result == -1)
+   {
+      platform_log("ERROR (%d): Linux failed to open input recording: \"%s\".\n", errno, file_path);
+      return(result);
+   }
+
+   // NOTE(law): Capture the save file the game is about to start from, so that
+   // playback begins in the same state.
+   struct platform_file save = platform_load_file(SOKOBAN_SAVE_FILE_PATH);
+
+   struct input_recording_header header = {0};
+   header.magic_number = INPUT_RECORDING_MAGIC_NUMBER;
+   header.version = INPUT_RECORDING_VERSION;
+   header.save_size = (u32)save.size;
+
+   bool success = (write(result, &header, sizeof(header)) == sizeof(header));
+   if(success && save.size > 0)
+   {
+      success = (write(result, save.memory, save.size) == save.size);
+   }
+   platform_free_file(&save);
+
+   if(!success)
+   {
+      platform_log("ERROR (%d): Linux failed to write input recording: \"%s\".\n", errno, file_path);
+
+      close(result);
+      result = -1;
+   }
+
+   return(result);
+}
+
+function void linux_record_input(int file, struct game_input *input, float frame_seconds_elapsed)
+{
+   struct input_recording_frame frame = pack_input_frame(input, frame_seconds_elapsed);
+   if(write(file, &frame, sizeof(frame)) != sizeof(frame))
+   {
+      platform_log("ERROR (%d): Linux failed to write input recording frame.\n", errno);
+   }
+}
+
 function u32 linux_get_processor_count()
 {
    u32 result = sysconf(_SC_NPROCESSORS_ONLN);
@@ -906,8 +1397,16 @@ function u32 linux_get_processor_count()
 
 int main(int argument_count, char **arguments)
 {
-   (void)argument_count;
-   (void)arguments;
+   // NOTE(law): Passing --record <path> writes every frame's input to the
+   // specified file, for later playback with sokoban_headless.
+   int recording_file = -1;
+   for(int index = 1; index < argument_count; ++index)
+   {
+      if(strcmp(arguments[index], "--record") == 0 && (index + 1) < argument_count)
+      {
+         recording_file = linux_begin_input_recording(arguments[++index]);
+      }
+   }
 
    u32 processor_count = linux_get_processor_count();
    u32 worker_thread_count = MINIMUM(processor_count, LINUX_WORKER_THREAD_COUNT);
@@ -915,6 +1414,8 @@ int main(int argument_count, char **arguments)
    struct platform_work_queue queue = {0};
    sem_init(&queue.semaphore, 0, 0);
 
+   linux_start_save_thread(&linux_global_save_queue);
+
    for(u32 index = 1; index < worker_thread_count; ++index)
    {
       pthread_t id;
@@ -929,16 +1430,14 @@ int main(int argument_count, char **arguments)
 
    // NOTE(law) Set up the rendering bitmap.
    struct game_renderer renderer = {0};
-   renderer.clear = software_clear;
-   renderer.rectangle = software_rectangle;
-   renderer.bitmap  = software_bitmap;
-   renderer.screen = software_screen;
+   initialize_software_renderer(&renderer);
 
    renderer.output.width = RESOLUTION_BASE_WIDTH;
    renderer.output.height = RESOLUTION_BASE_HEIGHT;
+   renderer.output.pitch = RENDER_BITMAP_PITCH(RESOLUTION_BASE_WIDTH);
 
    size_t bytes_per_pixel = sizeof(u32);
-   size_t bitmap_size = renderer.output.width * renderer.output.height * bytes_per_pixel;
+   size_t bitmap_size = renderer.output.pitch * renderer.output.height * bytes_per_pixel;
    renderer.output.memory = linux_allocate(bitmap_size);
    if(!renderer.output.memory)
    {
@@ -991,12 +1490,17 @@ int main(int argument_count, char **arguments)
 
       linux_process_events(window, &input);
 
+      if(recording_file != -1)
+      {
+         linux_record_input(recording_file, &input, frame_seconds_elapsed);
+      }
+
       // NOTE(law): Update game state.
       game_update(memory, &renderer, &input, &sound, &queue, frame_seconds_elapsed);
       // game_update(memory, bitmap, &input, &sound, &queue, target_seconds_per_frame);
 
       // NOTE(law): Blit bitmap to screen.
-      linux_display_bitmap(window, renderer.output);
+      linux_display_bitmap(window, renderer.output, renderer.dirty, renderer.dirty_count);
 
       // NOTE(law): Calculate elapsed frame time.
       struct timespec frame_end_count;
@@ -1036,6 +1540,13 @@ int main(int argument_count, char **arguments)
 #endif
    }
 
+   if(recording_file != -1)
+   {
+      close(recording_file);
+   }
+
+   linux_complete_saves(&linux_global_save_queue);
+
    XCloseDisplay(linux_global_display);
 
    return(0);
@@ -28,6 +28,14 @@ typedef dispatch_semaphore_t platform_semaphore;
 
 #define METAL_TEXTURE_INDEX_BASE_COLOR 0
 
+// NOTE(law): A native resolution render is upscaled by a whole factor, so it is
+// sampled without filtering to keep the pixel edges sharp.
+#if RENDER_AT_NATIVE_RESOLUTION
+#   define METAL_TEXTURE_FILTER nearest
+#else
+#   define METAL_TEXTURE_FILTER linear
+#endif
+
 #define S_(a) #a
 #define S(b) S_(b)
 
@@ -282,8 +290,8 @@ function void macos_initialize_metal(MTKView *view, u32 bitmap_width, u32 bitmap
    "sampling_shader(rasterizer_data in [[stage_in]],\n"
    "                texture2d<half> color_texture [[texture(" S(METAL_TEXTURE_INDEX_BASE_COLOR) ")]])\n"
    "{\n"
-   "   constexpr sampler textureSampler (mag_filter::linear,\n"
-   "                                     min_filter::linear);\n"
+   "   constexpr sampler textureSampler (mag_filter::" S(METAL_TEXTURE_FILTER) ",\n"
+   "                                     min_filter::" S(METAL_TEXTURE_FILTER) ");\n"
 
    "   // Sample the texture to obtain a color\n"
    "   const half4 colorSample = color_texture.sample(textureSampler, in.texture_coordinate);\n"
@@ -354,7 +362,7 @@ function void macos_display_bitmap(struct render_bitmap bitmap, MTKView *view)
       // double buffering.
       u32 texture_index = 0;
 
-      NSUInteger stride = 4 * bitmap.width;
+      NSUInteger stride = 4 * bitmap.pitch;
       MTLRegion region = {{0, 0, 0}, {bitmap.width, bitmap.height, 1}};
       [macos_global_textures[texture_index] replaceRegion:region mipmapLevel:0 withBytes:bitmap.memory bytesPerRow:stride];
 
@@ -484,6 +492,11 @@ function bool macos_process_keyboard(NSEvent *event, struct game_input *input)
             macos_set_key_state(&input->undo, key_is_pressed);
          } break;
 
+         case kVK_ANSI_Y:
+         {
+            macos_set_key_state(&input->redo, key_is_pressed);
+         } break;
+
          case kVK_ANSI_R:
          {
             macos_set_key_state(&input->reload, key_is_pressed);
@@ -517,6 +530,11 @@ function bool macos_process_keyboard(NSEvent *event, struct game_input *input)
          {
             macos_set_key_state(&input->function_keys[2], key_is_pressed);
          } break;
+
+         case kVK_F3:
+         {
+            macos_set_key_state(&input->function_keys[3], key_is_pressed);
+         } break;
       }
 
       result = true;
@@ -549,6 +567,435 @@ function bool macos_dequeue_work(struct platform_work_queue *queue)
    return(false);
 }
 
+function void *macos_allocate(size_t size)
+{
+   // NOTE(law): munmap() requires the size of the allocation in order to free
+   // the virtual memory. This function smuggles the allocation size just before
+   // the address that it actually returns. The header is padded out to
+   // RENDER_BITMAP_ALIGNMENT, so the result keeps that much of mmap's page
+   // alignment.
+
+   size_t allocation_size = size + RENDER_BITMAP_ALIGNMENT;
+   void *allocation = mmap(0, allocation_size, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+
+   if(allocation == MAP_FAILED)
+   {
+      platform_log("ERROR: macOS failed to allocate virtual memory.");
+      return(0);
+   }
+
+   void *result = (void *)((u8 *)allocation + RENDER_BITMAP_ALIGNMENT);
+   *((size_t *)result - 1) = allocation_size;
+
+   return(result);
+}
+
+function void macos_deallocate(void *memory)
+{
+   // NOTE(law): munmap() requires the size of the allocation in order to free
+   // the virtual memory. We always just want to dump the entire thing, so
+   // allocate() hides the allocation size just before the address it returns.
+
+   void *allocation = (void *)((u8 *)memory - RENDER_BITMAP_ALIGNMENT);
+   size_t allocation_size = *((size_t *)memory - 1);
+
+   if(munmap(allocation, allocation_size) != 0)
+   {
+      platform_log("ERROR: macOS failed to deallocate virtual memory.");
+   }
+}
+
+// NOTE(law): Queued saves are written by a dedicated thread, separate from the
+// work queue so that disk latency never stalls frame work. Requests wait until
+// none have arrived for MACOS_SAVE_COALESCE_SECONDS, so a burst of saves (e.g.
+// skipping through levels) only writes each file once. Appends are queued the
+// same way, so they land in order with any full writes of the same file. A
+// steady stream of requests never goes quiet, so nothing waits longer than
+// MACOS_SAVE_MAXIMUM_DELAY_SECONDS after the first request of a batch.
+
+#define MACOS_PENDING_SAVE_COUNT 8
+#define MACOS_SAVE_COALESCE_SECONDS 0.25
+#define MACOS_SAVE_MAXIMUM_DELAY_SECONDS 1.0
+
+struct macos_pending_save
+{
+   char file_path[256];
+   void *memory;
+   size_t size;
+   bool is_append;
+};
+
+struct macos_save_queue
+{
+   pthread_mutex_t mutex;
+   pthread_cond_t condition;
+
+   bool is_writing;
+   bool is_flushing;
+   bool is_synchronous;
+   struct timespec first_request;
+   struct timespec last_request;
+
+   u32 pending_count;
+   struct macos_pending_save pending[MACOS_PENDING_SAVE_COUNT];
+};
+
+global struct macos_save_queue macos_global_save_queue;
+
+function bool macos_write_and_sync(int file, void *memory, size_t size)
+{
+   u8 *bytes = (u8 *)memory;
+   size_t remaining = size;
+   while(remaining > 0)
+   {
+      ssize_t bytes_written = write(file, bytes, remaining);
+      if(bytes_written == -1 && errno == EINTR)
+      {
+         continue;
+      }
+      if(bytes_written <= 0)
+      {
+         break;
+      }
+
+      bytes += bytes_written;
+      remaining -= bytes_written;
+   }
+
+   // NOTE(law): fsync on macOS only hands the data to the drive, which may
+   // still hold it in a volatile cache. F_FULLFSYNC asks for it to be flushed
+   // to permanent storage, falling back to fsync where it is unsupported.
+   bool result = (remaining == 0 && (fcntl(file, F_FULLFSYNC) == 0 || fsync(file) == 0));
+   return(result);
+}
+
+function bool macos_write_file_atomically(char *file_path, void *memory, size_t size)
+{
+   // NOTE(law): Write to a temporary file next to the destination, flush it,
+   // then rename it over the destination. A crash at any point leaves either
+   // the complete old file or the complete new one.
+
+   bool result = false;
+
+   char temporary_path[512];
+   int length = snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", file_path);
+   if(length < 0 || length >= (int)sizeof(temporary_path))
+   {
+      platform_log("ERROR: macOS save path is too long: \"%s\".\n", file_path);
+      return(result);
+   }
+
+   int file = open(temporary_path, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+   if(file == -1)
+   {
+      platform_log("ERROR (%d): macOS failed to open file: \"%s\".\n", errno, temporary_path);
+      return(result);
+   }
+
+   result = macos_write_and_sync(file, memory, size);
+   close(file);
+
+   if(result)
+   {
+      result = (rename(temporary_path, file_path) == 0);
+   }
+
+   if(result)
+   {
+      // NOTE(law): Flush the directory as well, so that the rename itself
+      // survives a crash.
+      char directory_path[512];
+      length = snprintf(directory_path, sizeof(directory_path), "%s", file_path);
+      assert(length >= 0 && length < (int)sizeof(directory_path));
+
+      char *separator = strrchr(directory_path, '/');
+      if(separator)
+      {
+         *separator = 0;
+      }
+      else
+      {
+         snprintf(directory_path, sizeof(directory_path), ".");
+      }
+
+      int directory = open(directory_path, O_RDONLY);
+      if(directory != -1)
+      {
+         fsync(directory);
+         close(directory);
+      }
+   }
+   else
+   {
+      platform_log("ERROR (%d): macOS failed to write file: \"%s\".\n", errno, file_path);
+      unlink(temporary_path);
+   }
+
+   return(result);
+}
+
+function bool macos_append_file(char *file_path, void *memory, size_t size)
+{
+   // NOTE(law): A crash can leave a partial append at the end of the file. The
+   // game is expected to detect and discard it when the file is next read.
+
+   bool result = false;
+
+   int file = open(file_path, O_WRONLY|O_CREAT|O_APPEND, 0666);
+   if(file == -1)
+   {
+      platform_log("ERROR (%d): macOS failed to open file: \"%s\".\n", errno, file_path);
+      return(result);
+   }
+
+   result = macos_write_and_sync(file, memory, size);
+   close(file);
+
+   if(!result)
+   {
+      platform_log("ERROR (%d): macOS failed to append to file: \"%s\".\n", errno, file_path);
+   }
+
+   return(result);
+}
+
+function void macos_queue_file(char *file_path, void *memory, size_t size, bool is_append)
+{
+   struct macos_save_queue *queue = &macos_global_save_queue;
+
+   if(queue->is_synchronous)
+   {
+      // NOTE(law): Without a save thread, nothing would ever drain the queue.
+      if(is_append)
+      {
+         macos_append_file(file_path, memory, size);
+      }
+      else
+      {
+         macos_write_file_atomically(file_path, memory, size);
+      }
+      return;
+   }
+
+   // NOTE(law): Copy the data before taking the lock, so that the lock is only
+   // ever held for bookkeeping.
+   void *copy = macos_allocate(size);
+   if(!copy)
+   {
+      return;
+   }
+   memcpy(copy, memory, size);
+
+   pthread_mutex_lock(&queue->mutex);
+
+   struct macos_pending_save *save = 0;
+   for(u32 index = 0; index < queue->pending_count; ++index)
+   {
+      if(strcmp(queue->pending[index].file_path, file_path) == 0)
+      {
+         save = queue->pending + index;
+         break;
+      }
+   }
+
+   if(save && is_append)
+   {
+      // NOTE(law): Tack the new bytes onto whatever is already pending for this
+      // file, keeping the pending write's mode. An append after a full write
+      // becomes part of that write.
+      void *combined = macos_allocate(save->size + size);
+      if(combined)
+      {
+         memcpy(combined, save->memory, save->size);
+         memcpy((u8 *)combined + save->size, copy, size);
+
+         macos_deallocate(save->memory);
+         macos_deallocate(copy);
+
+         save->memory = combined;
+         save->size += size;
+      }
+      else
+      {
+         platform_log("ERROR: macOS failed to combine queued writes, dropping append to \"%s\".\n", file_path);
+         macos_deallocate(copy);
+      }
+
+      clock_gettime(CLOCK_REALTIME, &queue->last_request);
+      pthread_cond_broadcast(&queue->condition);
+   }
+   else
+   {
+      if(save)
+      {
+         macos_deallocate(save->memory);
+      }
+      else if(queue->pending_count < ARRAY_LENGTH(queue->pending))
+      {
+         if(queue->pending_count == 0)
+         {
+            clock_gettime(CLOCK_REALTIME, &queue->first_request);
+         }
+
+         save = queue->pending + queue->pending_count++;
+         snprintf(save->file_path, sizeof(save->file_path), "%s", file_path);
+      }
+
+      if(save)
+      {
+         save->memory = copy;
+         save->size = size;
+         save->is_append = is_append;
+
+         clock_gettime(CLOCK_REALTIME, &queue->last_request);
+         pthread_cond_broadcast(&queue->condition);
+      }
+      else
+      {
+         platform_log("ERROR: macOS save queue is full, dropping \"%s\".\n", file_path);
+         macos_deallocate(copy);
+      }
+   }
+
+   pthread_mutex_unlock(&queue->mutex);
+}
+
+function PLATFORM_QUEUE_SAVE_FILE(platform_queue_save_file)
+{
+   macos_queue_file(file_path, memory, size, false);
+}
+
+function PLATFORM_QUEUE_APPEND_FILE(platform_queue_append_file)
+{
+   macos_queue_file(file_path, memory, size, true);
+}
+
+function struct timespec macos_offset_time(struct timespec time, double seconds)
+{
+   struct timespec result = time;
+   result.tv_nsec += (long)(seconds * 1e9);
+   result.tv_sec += result.tv_nsec / 1000000000;
+   result.tv_nsec %= 1000000000;
+
+   return(result);
+}
+
+function void *macos_save_thread_procedure(void *parameter)
+{
+   struct macos_save_queue *queue = (struct macos_save_queue *)parameter;
+
+   pthread_mutex_lock(&queue->mutex);
+   while(1)
+   {
+      if(queue->pending_count == 0)
+      {
+         pthread_cond_wait(&queue->condition, &queue->mutex);
+         continue;
+      }
+
+      if(!queue->is_flushing)
+      {
+         struct timespec deadline = macos_offset_time(queue->last_request, MACOS_SAVE_COALESCE_SECONDS);
+         struct timespec latest = macos_offset_time(queue->first_request, MACOS_SAVE_MAXIMUM_DELAY_SECONDS);
+         if(latest.tv_sec < deadline.tv_sec || (latest.tv_sec == deadline.tv_sec && latest.tv_nsec < deadline.tv_nsec))
+         {
+            deadline = latest;
+         }
+
+         struct timespec now;
+         clock_gettime(CLOCK_REALTIME, &now);
+         if(now.tv_sec < deadline.tv_sec || (now.tv_sec == deadline.tv_sec && now.tv_nsec < deadline.tv_nsec))
+         {
+            pthread_cond_timedwait(&queue->condition, &queue->mutex, &deadline);
+            continue;
+         }
+      }
+
+      // NOTE(law): Take every pending save and write them without the lock held.
+      struct macos_pending_save saves[MACOS_PENDING_SAVE_COUNT];
+      u32 save_count = queue->pending_count;
+      memcpy(saves, queue->pending, save_count * sizeof(saves[0]));
+
+      queue->pending_count = 0;
+      queue->is_writing = true;
+      pthread_mutex_unlock(&queue->mutex);
+
+      for(u32 index = 0; index < save_count; ++index)
+      {
+         struct macos_pending_save *save = saves + index;
+         if(save->is_append)
+         {
+            macos_append_file(save->file_path, save->memory, save->size);
+         }
+         else
+         {
+            macos_write_file_atomically(save->file_path, save->memory, save->size);
+         }
+         macos_deallocate(save->memory);
+      }
+
+      pthread_mutex_lock(&queue->mutex);
+      queue->is_writing = false;
+      pthread_cond_broadcast(&queue->condition);
+   }
+
+   return(0);
+}
+
+function void macos_start_save_thread(struct macos_save_queue *queue)
+{
+   pthread_mutex_init(&queue->mutex, 0);
+   pthread_cond_init(&queue->condition, 0);
+
+   pthread_t id;
+   if(pthread_create(&id, 0, macos_save_thread_procedure, queue) != 0)
+   {
+      platform_log("ERROR: macOS failed to create the save thread, saves will be written synchronously.\n");
+      queue->is_synchronous = true;
+      return;
+   }
+
+   pthread_detach(id);
+}
+
+function void macos_complete_saves(struct macos_save_queue *queue)
+{
+   // NOTE(law): Block until every queued save is on disk.
+   pthread_mutex_lock(&queue->mutex);
+
+   queue->is_flushing = true;
+   pthread_cond_broadcast(&queue->condition);
+
+   while(queue->pending_count > 0 || queue->is_writing)
+   {
+      pthread_cond_wait(&queue->condition, &queue->mutex);
+   }
+
+   queue->is_flushing = false;
+   pthread_mutex_unlock(&queue->mutex);
+}
+
+function PLATFORM_FLUSH_FILE(platform_flush_file)
+{
+   // NOTE(law): The save thread doesn't track which files are in a write that
+   // is already under way, so any write in progress is waited on as well.
+   struct macos_save_queue *queue = &macos_global_save_queue;
+   pthread_mutex_lock(&queue->mutex);
+
+   bool is_pending = queue->is_writing;
+   for(u32 index = 0; !is_pending && index < queue->pending_count; ++index)
+   {
+      is_pending = (strcmp(queue->pending[index].file_path, file_path) == 0);
+   }
+
+   pthread_mutex_unlock(&queue->mutex);
+
+   if(is_pending)
+   {
+      macos_complete_saves(queue);
+   }
+}
+
 function PLATFORM_ENQUEUE_WORK(platform_enqueue_work)
 {
    u32 new_write_index = (queue->write_index + 1) % ARRAY_LENGTH(queue->entries);
@@ -667,6 +1114,8 @@ int main(int argument_count, char **arguments)
          pthread_detach(id);
       }
 
+      macos_start_save_thread(&macos_global_save_queue);
+
       NSApplication *app = [NSApplication sharedApplication];
       [NSApp setActivationPolicy:NSApplicationActivationPolicyRegular];
 
@@ -687,8 +1136,8 @@ int main(int argument_count, char **arguments)
       // NOTE(law): Create the main application window and delegate.
       NSRect screen_rect = [[NSScreen mainScreen] frame];
 
-      float client_width = RESOLUTION_BASE_WIDTH / 2;
-      float client_height = RESOLUTION_BASE_HEIGHT / 2;
+      float client_width = RESOLUTION_DISPLAY_WIDTH / 2;
+      float client_height = RESOLUTION_DISPLAY_HEIGHT / 2;
 
       NSRect client_rect = NSMakeRect((screen_rect.size.width - client_width) * 0.5,
                                       (screen_rect.size.height - client_height) * 0.5,
@@ -734,15 +1183,13 @@ int main(int argument_count, char **arguments)
 
       // NOTE(law) Set up the rendering bitmap.
       struct game_renderer renderer = {0};
-      renderer.clear = software_clear;
-      renderer.rectangle = software_rectangle;
-      renderer.bitmap  = software_bitmap;
-      renderer.screen = software_screen;
+      initialize_software_renderer(&renderer);
 
       renderer.output.width = RESOLUTION_BASE_WIDTH;
       renderer.output.height = RESOLUTION_BASE_HEIGHT;
+      renderer.output.pitch = RENDER_BITMAP_PITCH(RESOLUTION_BASE_WIDTH);
 
-      size_t bitmap_size = renderer.output.width * renderer.output.height * sizeof(u32);
+      size_t bitmap_size = renderer.output.pitch * renderer.output.height * sizeof(u32);
       renderer.output.memory = mmap(0, bitmap_size, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
       if(renderer.output.memory == MAP_FAILED)
       {
@@ -848,6 +1295,8 @@ int main(int argument_count, char **arguments)
          }
 #endif
       }
+
+      macos_complete_saves(&macos_global_save_queue);
    }
 
    return(0);
@@ -7,10 +7,8 @@
 enum platform_timer_id
 {
    PLATFORM_TIMER_game_update,
-   PLATFORM_TIMER_immediate_clear,
    PLATFORM_TIMER_render_push_background,
-   PLATFORM_TIMER_immediate_text,
-   PLATFORM_TIMER_immediate_screen_bitmap,
+   PLATFORM_TIMER_render,
    PLATFORM_TIMER_generate_blue_noise,
    PLATFORM_TIMER_mix_sound_samples,
 
@@ -0,0 +1,64 @@
+#if !defined(PLATFORM_RECORDING_H)
+/* /////////////////////////////////////////////////////////////////////////// */
+/* (c) copyright 2023 Lawrence D. Kern /////////////////////////////////////// */
+/* /////////////////////////////////////////////////////////////////////////// */
+
+// NOTE(law): An input recording is everything needed to replay a session
+// through game_update: the save file the game started from, then one packed
+// record per frame of the game_input struct and frame_seconds_elapsed. The game
+// itself is deterministic given those, so feeding a recording back in produces
+// the same frames bit for bit.
+
+#define INPUT_RECORDING_MAGIC_NUMBER 0x43455249 // IREC
+#define INPUT_RECORDING_VERSION 2
+
+struct input_recording_header
+{
+   u32 magic_number;
+   u32 version;
+
+   // NOTE(law): The contents of the save file at the time recording started
+   // immediately follow the header.
+   u32 save_size;
+   u32 reserved;
+};
+
+struct input_recording_frame
+{
+   // NOTE(law): One bit per entry in game_input.buttons.
+   u32 pressed;
+   u32 changed;
+
+   float frame_seconds_elapsed;
+};
+
+function struct input_recording_frame pack_input_frame(struct game_input *input, float frame_seconds_elapsed)
+{
+   assert(ARRAY_LENGTH(input->buttons) <= 32);
+
+   struct input_recording_frame result = {0};
+   result.frame_seconds_elapsed = frame_seconds_elapsed;
+
+   for(u32 index = 0; index < ARRAY_LENGTH(input->buttons); ++index)
+   {
+      result.pressed |= (u32)input->buttons[index].is_pressed << index;
+      result.changed |= (u32)input->buttons[index].changed_state << index;
+   }
+
+   return(result);
+}
+
+function float unpack_input_frame(struct input_recording_frame frame, struct game_input *input)
+{
+   for(u32 index = 0; index < ARRAY_LENGTH(input->buttons); ++index)
+   {
+      input->buttons[index].is_pressed = (frame.pressed >> index) & 1;
+      input->buttons[index].changed_state = (frame.changed >> index) & 1;
+   }
+
+   float result = frame.frame_seconds_elapsed;
+   return(result);
+}
+
+#define PLATFORM_RECORDING_H
+#endif
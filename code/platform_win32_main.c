@@ -13,6 +13,7 @@
 
 // NOTE(law): Standard headers.
 #include <stdio.h>
+#include <string.h>
 
 typedef HANDLE platform_semaphore;
 #include "platform.h"
@@ -155,6 +156,349 @@ function PLATFORM_SAVE_FILE(platform_save_file)
    return(result);
 }
 
+// NOTE(law): Queued saves are written by a dedicated thread, separate from the
+// work queue so that disk latency never stalls frame work. Requests wait until
+// none have arrived for WIN32_SAVE_COALESCE_SECONDS, so a burst of saves (e.g.
+// skipping through levels) only writes each file once. Appends are queued the
+// same way, so they land in order with any full writes of the same file. A
+// steady stream of requests never goes quiet, so nothing waits longer than
+// WIN32_SAVE_MAXIMUM_DELAY_SECONDS after the first request of a batch.
+
+#define WIN32_PENDING_SAVE_COUNT 8
+#define WIN32_SAVE_COALESCE_SECONDS 0.25f
+#define WIN32_SAVE_MAXIMUM_DELAY_SECONDS 1.0f
+
+struct win32_pending_save
+{
+   char file_path[256];
+   void *memory;
+   size_t size;
+   bool is_append;
+};
+
+struct win32_save_queue
+{
+   CRITICAL_SECTION lock;
+   CONDITION_VARIABLE condition;
+
+   bool is_writing;
+   bool is_flushing;
+   bool is_synchronous;
+   LARGE_INTEGER first_request;
+   LARGE_INTEGER last_request;
+
+   u32 pending_count;
+   struct win32_pending_save pending[WIN32_PENDING_SAVE_COUNT];
+};
+
+global struct win32_save_queue win32_global_save_queue;
+
+function bool win32_write_file_atomically(char *file_path, void *memory, size_t size)
+{
+   // NOTE(law): Write to a temporary file next to the destination, flush it,
+   // then move it over the destination. A crash at any point leaves either the
+   // complete old file or the complete new one.
+
+   bool result = false;
+
+   char temporary_path[512];
+   int length = snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", file_path);
+   if(length < 0 || length >= (int)sizeof(temporary_path))
+   {
+      platform_log("ERROR: Save path is too long: \"%s\".\n", file_path);
+      return(result);
+   }
+
+   HANDLE file = CreateFileA(temporary_path, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+   if(file == INVALID_HANDLE_VALUE)
+   {
+      platform_log("ERROR: Failed to open file \"%s\".\n", temporary_path);
+      return(result);
+   }
+
+   DWORD bytes_written;
+   BOOL success = WriteFile(file, memory, (DWORD)size, &bytes_written, 0);
+
+   result = (success && (size == (size_t)bytes_written) && FlushFileBuffers(file));
+   CloseHandle(file);
+
+   if(result)
+   {
+      result = MoveFileExA(temporary_path, file_path, MOVEFILE_REPLACE_EXISTING|MOVEFILE_WRITE_THROUGH);
+   }
+
+   if(!result)
+   {
+      platform_log("ERROR: Failed to write file \"%s.\"\n", file_path);
+      DeleteFileA(temporary_path);
+   }
+
+   return(result);
+}
+
+function bool win32_append_file(char *file_path, void *memory, size_t size)
+{
+   // NOTE(law): A crash can leave a partial append at the end of the file. The
+   // game is expected to detect and discard it when the file is next read.
+
+   bool result = false;
+
+   HANDLE file = CreateFileA(file_path, FILE_APPEND_DATA, 0, 0, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+   if(file == INVALID_HANDLE_VALUE)
+   {
+      platform_log("ERROR: Failed to open file \"%s\".\n", file_path);
+      return(result);
+   }
+
+   DWORD bytes_written;
+   BOOL success = WriteFile(file, memory, (DWORD)size, &bytes_written, 0);
+
+   result = (success && (size == (size_t)bytes_written) && FlushFileBuffers(file));
+   CloseHandle(file);
+
+   if(!result)
+   {
+      platform_log("ERROR: Failed to append to file \"%s.\"\n", file_path);
+   }
+
+   return(result);
+}
+
+function void *win32_allocate_save_memory(size_t size)
+{
+   void *result = VirtualAlloc(0, MAXIMUM(size, 1), MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+   if(!result)
+   {
+      platform_log("ERROR: Failed to allocate memory for a queued save.\n");
+   }
+
+   return(result);
+}
+
+function void win32_queue_file(char *file_path, void *memory, size_t size, bool is_append)
+{
+   struct win32_save_queue *queue = &win32_global_save_queue;
+
+   if(queue->is_synchronous)
+   {
+      // NOTE(law): Without a save thread, nothing would ever drain the queue.
+      if(is_append)
+      {
+         win32_append_file(file_path, memory, size);
+      }
+      else
+      {
+         win32_write_file_atomically(file_path, memory, size);
+      }
+      return;
+   }
+
+   // NOTE(law): Copy the data before taking the lock, so that the lock is only
+   // ever held for bookkeeping.
+   void *copy = win32_allocate_save_memory(size);
+   if(!copy)
+   {
+      return;
+   }
+   CopyMemory(copy, memory, size);
+
+   EnterCriticalSection(&queue->lock);
+
+   struct win32_pending_save *save = 0;
+   for(u32 index = 0; index < queue->pending_count; ++index)
+   {
+      if(strcmp(queue->pending[index].file_path, file_path) == 0)
+      {
+         save = queue->pending + index;
+         break;
+      }
+   }
+
+   if(save && is_append)
+   {
+      // NOTE(law): Tack the new bytes onto whatever is already pending for this
+      // file, keeping the pending write's mode. An append after a full write
+      // becomes part of that write.
+      void *combined = win32_allocate_save_memory(save->size + size);
+      if(combined)
+      {
+         CopyMemory(combined, save->memory, save->size);
+         CopyMemory((u8 *)combined + save->size, copy, size);
+
+         VirtualFree(save->memory, 0, MEM_RELEASE);
+         VirtualFree(copy, 0, MEM_RELEASE);
+
+         save->memory = combined;
+         save->size += size;
+      }
+      else
+      {
+         platform_log("ERROR: Failed to combine queued writes, dropping append to \"%s\".\n", file_path);
+         VirtualFree(copy, 0, MEM_RELEASE);
+      }
+
+      QueryPerformanceCounter(&queue->last_request);
+      WakeAllConditionVariable(&queue->condition);
+   }
+   else
+   {
+      if(save)
+      {
+         VirtualFree(save->memory, 0, MEM_RELEASE);
+      }
+      else if(queue->pending_count < ARRAY_LENGTH(queue->pending))
+      {
+         if(queue->pending_count == 0)
+         {
+            QueryPerformanceCounter(&queue->first_request);
+         }
+
+         save = queue->pending + queue->pending_count++;
+         snprintf(save->file_path, sizeof(save->file_path), "%s", file_path);
+      }
+
+      if(save)
+      {
+         save->memory = copy;
+         save->size = size;
+         save->is_append = is_append;
+
+         QueryPerformanceCounter(&queue->last_request);
+         WakeAllConditionVariable(&queue->condition);
+      }
+      else
+      {
+         platform_log("ERROR: Save queue is full, dropping \"%s\".\n", file_path);
+         VirtualFree(copy, 0, MEM_RELEASE);
+      }
+   }
+
+   LeaveCriticalSection(&queue->lock);
+}
+
+function PLATFORM_QUEUE_SAVE_FILE(platform_queue_save_file)
+{
+   win32_queue_file(file_path, memory, size, false);
+}
+
+function PLATFORM_QUEUE_APPEND_FILE(platform_queue_append_file)
+{
+   win32_queue_file(file_path, memory, size, true);
+}
+
+function DWORD WINAPI win32_save_thread_procedure(void *parameter)
+{
+   struct win32_save_queue *queue = (struct win32_save_queue *)parameter;
+
+   EnterCriticalSection(&queue->lock);
+   while(1)
+   {
+      if(queue->pending_count == 0)
+      {
+         SleepConditionVariableCS(&queue->condition, &queue->lock, INFINITE);
+         continue;
+      }
+
+      if(!queue->is_flushing)
+      {
+         LARGE_INTEGER now;
+         QueryPerformanceCounter(&now);
+
+         float seconds_remaining = MINIMUM(WIN32_SAVE_COALESCE_SECONDS - WIN32_SECONDS_ELAPSED(queue->last_request, now),
+                                           WIN32_SAVE_MAXIMUM_DELAY_SECONDS - WIN32_SECONDS_ELAPSED(queue->first_request, now));
+         if(seconds_remaining > 0)
+         {
+            SleepConditionVariableCS(&queue->condition, &queue->lock, (DWORD)(seconds_remaining * 1000.0f) + 1);
+            continue;
+         }
+      }
+
+      // NOTE(law): Take every pending save and write them without the lock held.
+      struct win32_pending_save saves[WIN32_PENDING_SAVE_COUNT];
+      u32 save_count = queue->pending_count;
+      CopyMemory(saves, queue->pending, save_count * sizeof(saves[0]));
+
+      queue->pending_count = 0;
+      queue->is_writing = true;
+      LeaveCriticalSection(&queue->lock);
+
+      for(u32 index = 0; index < save_count; ++index)
+      {
+         struct win32_pending_save *save = saves + index;
+         if(save->is_append)
+         {
+            win32_append_file(save->file_path, save->memory, save->size);
+         }
+         else
+         {
+            win32_write_file_atomically(save->file_path, save->memory, save->size);
+         }
+         VirtualFree(save->memory, 0, MEM_RELEASE);
+      }
+
+      EnterCriticalSection(&queue->lock);
+      queue->is_writing = false;
+      WakeAllConditionVariable(&queue->condition);
+   }
+
+   return(0);
+}
+
+function void win32_start_save_thread(struct win32_save_queue *queue)
+{
+   InitializeCriticalSection(&queue->lock);
+   InitializeConditionVariable(&queue->condition);
+
+   DWORD thread_id;
+   HANDLE thread_handle = CreateThread(0, 0, win32_save_thread_procedure, queue, 0, &thread_id);
+   if(!thread_handle)
+   {
+      platform_log("ERROR: Windows failed to create the save thread, saves will be written synchronously.\n");
+      queue->is_synchronous = true;
+      return;
+   }
+
+   CloseHandle(thread_handle);
+}
+
+function void win32_complete_saves(struct win32_save_queue *queue)
+{
+   // NOTE(law): Block until every queued save is on disk.
+   EnterCriticalSection(&queue->lock);
+
+   queue->is_flushing = true;
+   WakeAllConditionVariable(&queue->condition);
+
+   while(queue->pending_count > 0 || queue->is_writing)
+   {
+      SleepConditionVariableCS(&queue->condition, &queue->lock, INFINITE);
+   }
+
+   queue->is_flushing = false;
+   LeaveCriticalSection(&queue->lock);
+}
+
+function PLATFORM_FLUSH_FILE(platform_flush_file)
+{
+   // NOTE(law): The save thread doesn't track which files are in a write that
+   // is already under way, so any write in progress is waited on as well.
+   struct win32_save_queue *queue = &win32_global_save_queue;
+   EnterCriticalSection(&queue->lock);
+
+   bool is_pending = queue->is_writing;
+   for(u32 index = 0; !is_pending && index < queue->pending_count; ++index)
+   {
+      is_pending = (strcmp(queue->pending[index].file_path, file_path) == 0);
+   }
+
+   LeaveCriticalSection(&queue->lock);
+
+   if(is_pending)
+   {
+      win32_complete_saves(queue);
+   }
+}
+
 function PLATFORM_ENQUEUE_WORK(platform_enqueue_work)
 {
    u32 new_write_index = (queue->write_index + 1) % ARRAY_LENGTH(queue->entries);
@@ -533,8 +877,8 @@ LRESULT win32_window_callback(HWND window, UINT message, WPARAM wparam, LPARAM l
          if(!win32_is_fullscreen(window))
          {
             RECT window_rect = {0};
-            window_rect.right  = RESOLUTION_BASE_WIDTH;
-            window_rect.bottom = RESOLUTION_BASE_HEIGHT;
+            window_rect.right  = RESOLUTION_DISPLAY_WIDTH;
+            window_rect.bottom = RESOLUTION_DISPLAY_HEIGHT;
 
             if(win32_global_dpi > WIN32_DEFAULT_DPI)
             {
@@ -688,6 +1032,12 @@ function bool win32_process_keyboard(MSG message, struct game_input *input)
             input->undo.changed_state = key_changed_state;
          } break;
 
+         case 'Y':
+         {
+            input->redo.is_pressed = key_is_pressed;
+            input->redo.changed_state = key_changed_state;
+         } break;
+
          case 'R':
          {
             input->reload.is_pressed = key_is_pressed;
@@ -727,6 +1077,12 @@ function bool win32_process_keyboard(MSG message, struct game_input *input)
             input->function_keys[2].changed_state = key_changed_state;
          } break;
 
+         case VK_F3:
+         {
+            input->function_keys[3].is_pressed = key_is_pressed;
+            input->function_keys[3].changed_state = key_changed_state;
+         } break;
+
          case VK_F4:
          {
             if(is_alt_pressed)
@@ -767,6 +1123,8 @@ int WinMain(HINSTANCE instance, HINSTANCE previous_instance, LPSTR command_line,
    struct platform_work_queue queue = {0};
    queue.semaphore = CreateSemaphoreExA(0, 0, worker_thread_count, 0, 0, SEMAPHORE_ALL_ACCESS);
 
+   win32_start_save_thread(&win32_global_save_queue);
+
    for(u32 index = 1; index < worker_thread_count; ++index)
    {
       DWORD thread_id;
@@ -819,16 +1177,14 @@ int WinMain(HINSTANCE instance, HINSTANCE previous_instance, LPSTR command_line,
 
    // NOTE(law) Set up the rendering bitmap.
    struct game_renderer renderer = {0};
-   renderer.clear = software_clear;
-   renderer.rectangle = software_rectangle;
-   renderer.bitmap  = software_bitmap;
-   renderer.screen = software_screen;
+   initialize_software_renderer(&renderer);
 
    renderer.output.width = RESOLUTION_BASE_WIDTH;
    renderer.output.height = RESOLUTION_BASE_HEIGHT;
+   renderer.output.pitch = RENDER_BITMAP_PITCH(RESOLUTION_BASE_WIDTH);
 
    SIZE_T bytes_per_pixel = sizeof(u32);
-   SIZE_T bitmap_size = renderer.output.width * renderer.output.height * bytes_per_pixel;
+   SIZE_T bitmap_size = renderer.output.pitch * renderer.output.height * bytes_per_pixel;
    renderer.output.memory = VirtualAlloc(0, bitmap_size, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
    if(!renderer.output.memory)
    {
@@ -839,7 +1195,9 @@ int WinMain(HINSTANCE instance, HINSTANCE previous_instance, LPSTR command_line,
    // NOTE(law): Initialize render bitmap.
    BITMAPINFOHEADER bitmap_header = {0};
    bitmap_header.biSize = sizeof(BITMAPINFOHEADER);
-   bitmap_header.biWidth = renderer.output.width;
+   // NOTE(law): The DIB's width sets its row stride, and StretchDIBits only
+   // reads the output's actual width from each row.
+   bitmap_header.biWidth = renderer.output.pitch;
    bitmap_header.biHeight = -(s32)renderer.output.height; // NOTE(law): Negative will indicate a top-down bitmap.
    bitmap_header.biPlanes = 1;
    bitmap_header.biBitCount = 32;
@@ -984,5 +1342,7 @@ int WinMain(HINSTANCE instance, HINSTANCE previous_instance, LPSTR command_line,
 #endif
    }
 
+   win32_complete_saves(&win32_global_save_queue);
+
    return(0);
 }
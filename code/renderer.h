@@ -3,19 +3,86 @@
 /* (c) copyright 2023 Lawrence D. Kern /////////////////////////////////////// */
 /* /////////////////////////////////////////////////////////////////////////// */
 
+enum render_bitmap_opacity
+{
+   // NOTE(law): Masked bitmaps only contain fully opaque and fully transparent
+   // pixels. The default is translucent, which is always safe to assume.
+   RENDER_BITMAP_TRANSLUCENT,
+   RENDER_BITMAP_MASKED,
+   RENDER_BITMAP_OPAQUE,
+};
+
+// NOTE(law): Rows of a bitmap are pitch pixels apart. Bitmaps that whole
+// screens are drawn into (the output, the background cache and the transition
+// snapshot) start on a RENDER_BITMAP_ALIGNMENT boundary and pad their rows to a
+// multiple of it, so that every row starts aligned too. The clear and screen
+// kernels rely on this to use aligned loads and streaming stores. Other
+// bitmaps, like the art and glyphs, are only read through unaligned loads and
+// keep pitch equal to width.
+
+#define RENDER_BITMAP_ALIGNMENT 64
+#define RENDER_BITMAP_PITCH(width) (((width) + (RENDER_BITMAP_ALIGNMENT / 4) - 1) & ~((RENDER_BITMAP_ALIGNMENT / 4) - 1))
+
 struct render_bitmap
 {
    s32 width;
    s32 height;
+   s32 pitch;
 
    s32 offsetx;
    s32 offsety;
 
+   enum render_bitmap_opacity opacity;
+   u32 version;
    u32 *memory;
 };
 
+struct render_clip
+{
+   // NOTE(law): Pixel bounds, with min inclusive and max exclusive.
+   s32 minx;
+   s32 miny;
+   s32 maxx;
+   s32 maxy;
+};
+
 #define COMPUTE_FONT_HEIGHT(font, scale) (((font).ascent - (font).descent + (font).line_gap) * (scale))
 
+// NOTE(law): render_push_text lays out each distinct string once per position,
+// compositing its glyphs into a run bitmap that is then drawn with a single
+// entry. Runs live in a small hash table keyed on the string and position. When
+// the table or the pixel pool fills up, the whole cache is emptied at the start
+// of the next frame (runs pushed earlier in the frame still need their pixels).
+
+#define TEXT_RUN_CACHE_SLOT_COUNT 128
+#define TEXT_RUN_CACHE_POOL_SIZE (1024 * 1024)
+#define TEXT_RUN_MAX_LENGTH 64
+
+struct text_run
+{
+   u64 hash;
+   float posx;
+   float posy;
+   char text[TEXT_RUN_MAX_LENGTH];
+
+   struct render_bitmap bitmap;
+   s32 x;
+   s32 y;
+};
+
+struct text_run_cache
+{
+   u32 run_count;
+   struct text_run runs[TEXT_RUN_CACHE_SLOT_COUNT];
+
+   bool is_full;
+   u32 full_frame_index;
+   u32 version;
+
+   u32 pool_used;
+   u32 *pool;
+};
+
 struct font_glyphs
 {
    float ascent;
@@ -24,18 +91,25 @@ struct font_glyphs
 
    struct render_bitmap glyphs[128];
    float *pair_distances;
+
+   struct text_run_cache *runs;
 };
 
-#define RENDERER_CLEAR(name) void name(struct render_bitmap destination, u32 color)
+// NOTE(law): Every renderer function only writes pixels inside clip, which must
+// lie within destination. The clear and screen functions process 4 pixels at a
+// time, and expect the horizontal clip bounds to be multiples of 4. They also
+// expect their destination (and source) to be aligned, with a padded pitch.
+
+#define RENDERER_CLEAR(name) void name(struct render_bitmap destination, struct render_clip clip, u32 color)
 typedef RENDERER_CLEAR(renderer_clear);
 
-#define RENDERER_RECTANGLE(name) void name(struct render_bitmap destination, v2 min, v2 max, u32 color)
+#define RENDERER_RECTANGLE(name) void name(struct render_bitmap destination, struct render_clip clip, v2 min, v2 max, u32 color)
 typedef RENDERER_RECTANGLE(renderer_rectangle);
 
-#define RENDERER_BITMAP(name) void name(struct render_bitmap destination, struct render_bitmap source, float posx, float posy, s32 render_width, s32 render_height)
+#define RENDERER_BITMAP(name) void name(struct render_bitmap destination, struct render_clip clip, struct render_bitmap source, float posx, float posy, s32 render_width, s32 render_height)
 typedef RENDERER_BITMAP(renderer_bitmap);
 
-#define RENDERER_SCREEN(name) void name(struct render_bitmap destination, struct render_bitmap source, float alpha_modulation)
+#define RENDERER_SCREEN(name) void name(struct render_bitmap destination, struct render_clip clip, struct render_bitmap source, float alpha_modulation)
 typedef RENDERER_SCREEN(renderer_screen);
 
 enum render_queue_entry_type
@@ -44,32 +118,109 @@ enum render_queue_entry_type
    RENDER_QUEUE_ENTRY_TYPE_RECTANGLE,
    RENDER_QUEUE_ENTRY_TYPE_BITMAP,
    RENDER_QUEUE_ENTRY_TYPE_SCREEN,
+
+   RENDER_QUEUE_ENTRY_TYPE_COUNT,
 };
 
-struct render_queue_entry
-{
-   enum render_queue_entry_type type;
+// NOTE(law): A queue is a stream of commands packed into a u32 each: the entry
+// type in the top byte, and the index of its payload in the low 24 bits. The
+// payloads live in a separate array per type, shared by every layer. Bitmaps
+// are stored once per frame in a table and referred to by a 24-bit handle, so
+// the payloads stay small and hold no pointers. Rectangle corners are stored as
+// whole pixels, which is all the rectangle function uses.
+
+#define RENDER_COMMAND(type, payload) (((u32)(type) << 24) | (payload))
+#define RENDER_COMMAND_TYPE(command) ((enum render_queue_entry_type)((command) >> 24))
+#define RENDER_COMMAND_PAYLOAD(command) ((command) & 0xFFFFFF)
 
+struct render_rectangle_command
+{
+   s16 minx;
+   s16 miny;
+   s16 maxx;
+   s16 maxy;
    u32 color;
+};
+
+struct render_bitmap_command
+{
+   float posx;
+   float posy;
+   s16 width;
+   s16 height;
+   u32 bitmap;
+};
+
+struct render_screen_command
+{
+   u32 bitmap;
    float alpha_modulation;
+};
+
+struct memory_arena;
+
+struct render_payloads
+{
+   struct memory_arena *arena;
+
+   // NOTE(law): Arena space held back for what render allocates per command,
+   // so that render never runs out once the commands are pushed.
+   size_t reserved_size;
+   u32 dropped_count;
 
-   union
-   {
-      struct {v2 min; v2 max;};
-      struct {float posx; float posy; s32 width; s32 height;};
-   };
-
-   union
-   {
-      struct render_bitmap bitmap;
-      struct {struct font_glyphs *font; char *format;};
-   };
+   u32 clear_count;
+   u32 clear_capacity;
+   u32 *clears;
+
+   u32 rectangle_count;
+   u32 rectangle_capacity;
+   struct render_rectangle_command *rectangles;
+
+   u32 bitmap_command_count;
+   u32 bitmap_command_capacity;
+   struct render_bitmap_command *bitmap_commands;
+
+   u32 screen_count;
+   u32 screen_capacity;
+   struct render_screen_command *screens;
+
+   // NOTE(law): The bitmap table is indexed by handle. The slots are an open
+   // addressing hash of handle + 1 (zero is empty), twice the table capacity.
+   u32 bitmap_count;
+   u32 bitmap_capacity;
+   struct render_bitmap *bitmaps;
+   u32 *bitmap_slots;
 };
 
+// NOTE(law): Queue storage is allocated from a frame arena that the game
+// empties at the start of each frame, and each array is moved to a block twice
+// the size whenever it fills up. If the arena itself runs out, commands are
+// dropped with a warning rather than overrunning it. Each command gets a sort
+// key of its layer, depth and bitmap handle:
+//
+//    bits 56-63  layer
+//    bits 24-55  depth
+//    bits  0-23  bitmap handle plus one (zero for entries without a bitmap)
+//
+// render sorts the commands by key before binning them. By default every entry
+// is pushed at a new depth, so submission order is kept. Entries pushed between
+// render_begin_batch and render_end_batch share a depth, which tells the
+// renderer they can be drawn in any order. Within a batch, entries using the
+// same bitmap end up next to each other.
+
+#define RENDER_QUEUE_INITIAL_CAPACITY 256
+
 struct render_queue
 {
+   struct render_payloads *payloads;
+
    u32 entry_count;
-   struct render_queue_entry entries[4098];
+   u32 entry_capacity;
+   u32 *commands;
+   u64 *sort_keys;
+
+   u32 depth;
+   bool is_batching;
 };
 
 enum render_layer
@@ -80,6 +231,36 @@ enum render_layer
    RENDER_LAYER_COUNT,
 };
 
+// NOTE(law): The output is split into a grid of render tiles, which are
+// rasterized in parallel on the work queue. Each tile has a bin of the commands
+// that overlap it, in sorted order.
+
+#define RENDER_TILE_COUNT_X 6
+#define RENDER_TILE_COUNT_Y 4
+#define RENDER_TILE_COUNT (RENDER_TILE_COUNT_X * RENDER_TILE_COUNT_Y)
+
+struct render_tile
+{
+   struct game_renderer *renderer;
+   struct render_clip clip;
+
+   u32 bin_offset;
+   u32 bin_count;
+
+   u64 hash;
+   u64 previous_hash;
+};
+
+// NOTE(law): A render tile is only rasterized again when the hash of its binned
+// entries differs from last frame, or when part of it was reported damaged. The
+// output keeps last frame's pixels everywhere else. Entries refer to bitmaps by
+// address and version, so code that rewrites a bitmap's pixels in place must
+// either bump its version or report the area of the output that depends on
+// them with render_damage. After render, dirty lists the rectangles of the
+// output that changed.
+
+#define RENDER_DAMAGE_CAPACITY 64
+
 struct game_renderer
 {
    renderer_clear *clear;
@@ -89,6 +270,18 @@ struct game_renderer
 
    struct render_queue queue[RENDER_LAYER_COUNT];
    struct render_bitmap output;
+   struct render_payloads payloads;
+
+   struct render_tile tiles[RENDER_TILE_COUNT];
+   u32 *bins;
+
+   u32 damage_count;
+   struct render_clip damage[RENDER_DAMAGE_CAPACITY];
+
+   u32 dirty_count;
+   struct render_clip dirty[RENDER_TILE_COUNT];
+
+   u32 frame_index;
 };
 
 #define RENDERER_H
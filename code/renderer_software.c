@@ -2,196 +2,465 @@
 /* (c) copyright 2023 Lawrence D. Kern /////////////////////////////////////// */
 /* /////////////////////////////////////////////////////////////////////////// */
 
-function RENDERER_CLEAR(software_clear)
+function RENDERER_RECTANGLE(software_rectangle)
 {
-   TIMER_BEGIN(immediate_clear);
-
-   // START:   6830424 cycles
-   // CURRENT: 1860670 cycles
+   s32 minx = MAXIMUM(clip.minx, (s32)min.x);
+   s32 miny = MAXIMUM(clip.miny, (s32)min.y);
+   s32 maxx = MINIMUM((s32)max.x, clip.maxx - 1);
+   s32 maxy = MINIMUM((s32)max.y, clip.maxy - 1);
 
-   u32_4x wide_color = u32_4x_set1(color);
-
-   assert((destination.width % 4) == 0);
-   for(s32 y = 0; y < destination.height; ++y)
+   for(s32 y = miny; y <= maxy; ++y)
    {
-      u32 *row = destination.memory + (y * destination.width);
-      for(s32 x = 0; x < destination.width; x += 4)
+      for(s32 x = minx; x <= maxx; ++x)
       {
-         // TODO(law): Align memory to 16-byte boundary so we don't need unaligned stores.
-         u32_4x_storeu((row + x), wide_color);
+         destination.memory[(y * destination.pitch) + x] = color;
       }
    }
+}
+
+// NOTE(law): The clear, screen and bitmap kernels are compiled once per
+// instruction set from renderer_software_kernels.c, and initialize_software_renderer
+// picks the widest one the current CPU supports. The same release binary then
+// runs 16-wide on AVX-512 machines and 4-wide on SSE2 machines.
 
-   TIMER_END(immediate_clear);
+global float software_lane_indices[16] =
+{
+   0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f,
+   8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f,
+};
+
+function u32_4x u32_4x_gather(u32 *base, u32_4x indices)
+{
+   // NOTE(law): There is no gather in SSE2 or NEON, so fetch the four values
+   // individually.
+   u32 index[4];
+   u32_4x_storeu(index, indices);
+
+   u32 values[4] = {base[index[0]], base[index[1]], base[index[2]], base[index[3]]};
+
+   u32_4x result = u32_4x_loadu(values);
+   return(result);
 }
 
-function RENDERER_RECTANGLE(software_rectangle)
+function u32 software_blend(u32 source, u32 destination)
 {
-   s32 minx = MAXIMUM(0, (s32)min.x);
-   s32 miny = MAXIMUM(0, (s32)min.y);
-   s32 maxx = MINIMUM((s32)max.x, destination.width - 1);
-   s32 maxy = MINIMUM((s32)max.y, destination.height - 1);
+   // NOTE(law): Scalar reference for the kernels' blend. Composite premultiplied
+   // source over destination, rounding each channel's destination term to the
+   // nearest integer. Sums are clamped to 255 like the kernels' saturating pack,
+   // though premultiplied inputs never reach that.
+   u32 inverse_alpha = 255 - (source >> 24);
+
+   u32 result = 0;
+   for(u32 shift = 0; shift < 32; shift += 8)
+   {
+      u32 s = (source >> shift) & 0xFF;
+      u32 d = (destination >> shift) & 0xFF;
 
-   for(s32 y = miny; y <= maxy; ++y)
+      u32 channel = s + (((d * inverse_alpha) + 127) / 255);
+      result |= MINIMUM(channel, 255) << shift;
+   }
+
+   return(result);
+}
+
+function u32 software_modulate(u32 color, u32 modulation)
+{
+   // NOTE(law): Scalar reference for the kernels' modulation. Scale every
+   // channel of a premultiplied color by modulation / 255, rounded.
+   u32 result = 0;
+   for(u32 shift = 0; shift < 32; shift += 8)
    {
-      for(s32 x = minx; x <= maxx; ++x)
-      {
-         destination.memory[(y * destination.width) + x] = color;
-      }
+      u32 c = (color >> shift) & 0xFF;
+      result |= (((c * modulation) + 127) / 255) << shift;
    }
+
+   return(result);
 }
 
-function RENDERER_SCREEN(software_screen)
+// NOTE(law): Clears of at least this many pixels (4MB) use streaming stores.
+#define SOFTWARE_STREAMING_CLEAR_PIXELS (1024 * 1024)
+
+function bool is_render_bitmap_aligned(struct render_bitmap bitmap)
 {
-   // START:   29638612 cycles
-   // CURRENT: 10728806 cycles
+   // NOTE(law): Whether every row of bitmap starts on a RENDER_BITMAP_ALIGNMENT
+   // boundary, as allocate_render_bitmap arranges.
+   bool result = (((uintptr_t)bitmap.memory % RENDER_BITMAP_ALIGNMENT) == 0 &&
+                  ((bitmap.pitch * sizeof(u32)) % RENDER_BITMAP_ALIGNMENT) == 0);
+   return(result);
+}
 
-   assert(destination.width == source.width);
-   assert(destination.height == source.height);
+function u32 software_modulation(float alpha_modulation)
+{
+   // NOTE(law): Quantize a [0, 1] alpha modulation to the 8-bit fraction used by
+   // software_modulate.
+   if(alpha_modulation < 0.0f) alpha_modulation = 0.0f;
+   if(alpha_modulation > 1.0f) alpha_modulation = 1.0f;
 
-   TIMER_BEGIN(immediate_screen_bitmap);
+   u32 result = (u32)((alpha_modulation * 255.0f) + 0.5f);
+   return(result);
+}
 
-   u32_4x wide_mask255      = u32_4x_set1(0xFF);
-   f32_4x wide_one          = f32_4x_set1(1.0f);
-   f32_4x wide_255          = f32_4x_set1(255.0f);
-   f32_4x wide_one_over_255 = f32_4x_set1(1.0f / 255.0f);
+// NOTE(law): The per-pixel helpers must be inlined into their callers. The wide
+// kernels finish each row with the 4-wide helpers, and an out-of-line call from
+// AVX code into SSE code pays a register state transition every time.
+
+#if _MSC_VER
+#   define KERNEL_INLINE __forceinline
+#else
+#   define KERNEL_INLINE inline __attribute__((always_inline))
+#endif
+
+// NOTE(law): 4-wide kernels, available everywhere.
+
+#if __ARM_NEON
+#   define KERNEL_BASE_NAME(name) name##_neon
+#else
+#   define KERNEL_BASE_NAME(name) name##_sse2
+#endif
+#define KERNEL_NAME(name) KERNEL_BASE_NAME(name)
+#define KERNEL_TARGET
+#define KERNEL_WIDTH 4
+
+#define wide_u32 u32_4x
+#define wide_u32_set1 u32_4x_set1
+#define wide_u32_loadu u32_4x_loadu
+#define wide_u32_storeu u32_4x_storeu
+#define wide_u32_load u32_4x_load
+#define wide_u32_store u32_4x_store
+#define wide_u32_stream u32_4x_stream
+#define wide_u32_truncate_f32 u32_4x_truncate_f32_4x
+#define wide_u32_gather u32_4x_gather
+#define wide_u32_pack u32_4x_pack_u16_8x
+#define wide_u32_srai u32_4x_srai
+#define wide_u32_select u32_4x_select
+
+#define wide_u16 u16_8x
+#define wide_u16_set1 u16_8x_set1
+#define wide_u16_add u16_8x_add
+#define wide_u16_sub u16_8x_sub
+#define wide_u16_mul u16_8x_mul
+#define wide_u16_div255 u16_8x_div255
+#define wide_u16_unpacklo u16_8x_unpacklo_u32_4x
+#define wide_u16_unpackhi u16_8x_unpackhi_u32_4x
+#define wide_u16_broadcast3 u16_8x_broadcast3
+
+#define wide_f32 f32_4x
+#define wide_f32_set1 f32_4x_set1
+#define wide_f32_loadu f32_4x_loadu
+#define wide_f32_add f32_4x_add
+#define wide_f32_mul f32_4x_mul
+#define wide_f32_div f32_4x_div
+#define wide_f32_min f32_4x_min
+#define wide_f32_max f32_4x_max
+
+#include "renderer_software_kernels.c"
+
+#undef KERNEL_NAME
+#undef KERNEL_TARGET
+#undef KERNEL_WIDTH
+
+#undef wide_u32
+#undef wide_u32_set1
+#undef wide_u32_loadu
+#undef wide_u32_storeu
+#undef wide_u32_load
+#undef wide_u32_store
+#undef wide_u32_stream
+#undef wide_u32_truncate_f32
+#undef wide_u32_gather
+#undef wide_u32_pack
+#undef wide_u32_srai
+#undef wide_u32_select
+
+#undef wide_u16
+#undef wide_u16_set1
+#undef wide_u16_add
+#undef wide_u16_sub
+#undef wide_u16_mul
+#undef wide_u16_div255
+#undef wide_u16_unpacklo
+#undef wide_u16_unpackhi
+#undef wide_u16_broadcast3
+
+#undef wide_f32
+#undef wide_f32_set1
+#undef wide_f32_loadu
+#undef wide_f32_add
+#undef wide_f32_mul
+#undef wide_f32_div
+#undef wide_f32_min
+#undef wide_f32_max
+
+#if !__ARM_NEON
+// NOTE(law): 8-wide AVX2 kernels. MSVC allows AVX intrinsics in any function,
+// while gcc and clang need each function marked with the target. The 16-bit
+// unpack and pack instructions work within each 128-bit half, which is fine
+// since they are always used in matching pairs.
+
+#if _MSC_VER
+#   define KERNEL_TARGET
+#else
+#   define KERNEL_TARGET __attribute__((target("avx2")))
+#endif
+#define KERNEL_NAME(name) name##_avx2
+#define KERNEL_WIDTH 8
+
+#define wide_u32 __m256i
+#define wide_u32_set1(v) _mm256_set1_epi32(v)
+#define wide_u32_loadu(p) _mm256_loadu_si256((__m256i *)(p))
+#define wide_u32_storeu(p, v) _mm256_storeu_si256((__m256i *)(p), (v))
+#define wide_u32_load(p) _mm256_load_si256((__m256i *)(p))
+#define wide_u32_store(p, v) _mm256_store_si256((__m256i *)(p), (v))
+#define wide_u32_stream(p, v) _mm256_stream_si256((__m256i *)(p), (v))
+#define wide_u32_truncate_f32(v) _mm256_cvttps_epi32(v)
+#define wide_u32_gather(base, indices) _mm256_i32gather_epi32((int *)(base), (indices), 4)
+#define wide_u32_pack(lo, hi) _mm256_packus_epi16((lo), (hi))
+#define wide_u32_srai(v, n) _mm256_srai_epi32((v), (n))
+#define wide_u32_select(mask, a, b) _mm256_blendv_epi8((b), (a), (mask))
+
+#define wide_u16 __m256i
+#define wide_u16_set1(v) _mm256_set1_epi16((short)(v))
+#define wide_u16_add(a, b) _mm256_add_epi16((a), (b))
+#define wide_u16_sub(a, b) _mm256_sub_epi16((a), (b))
+#define wide_u16_mul(a, b) _mm256_mullo_epi16((a), (b))
+#define wide_u16_div255(v) _mm256_srli_epi16(_mm256_mulhi_epu16(_mm256_add_epi16((v), _mm256_set1_epi16(127)), _mm256_set1_epi16((short)0x8081)), 7)
+#define wide_u16_unpacklo(v) _mm256_unpacklo_epi8((v), _mm256_setzero_si256())
+#define wide_u16_unpackhi(v) _mm256_unpackhi_epi8((v), _mm256_setzero_si256())
+#define wide_u16_broadcast3(v) _mm256_shufflehi_epi16(_mm256_shufflelo_epi16((v), 0xFF), 0xFF)
+
+#define wide_f32 __m256
+#define wide_f32_set1(v) _mm256_set1_ps(v)
+#define wide_f32_loadu(p) _mm256_loadu_ps(p)
+#define wide_f32_add(a, b) _mm256_add_ps((a), (b))
+#define wide_f32_mul(a, b) _mm256_mul_ps((a), (b))
+#define wide_f32_div(a, b) _mm256_div_ps((a), (b))
+#define wide_f32_min(a, b) _mm256_min_ps((a), (b))
+#define wide_f32_max(a, b) _mm256_max_ps((a), (b))
+
+#include "renderer_software_kernels.c"
+
+#undef KERNEL_NAME
+#undef KERNEL_TARGET
+#undef KERNEL_WIDTH
+
+#undef wide_u32
+#undef wide_u32_set1
+#undef wide_u32_loadu
+#undef wide_u32_storeu
+#undef wide_u32_load
+#undef wide_u32_store
+#undef wide_u32_stream
+#undef wide_u32_truncate_f32
+#undef wide_u32_gather
+#undef wide_u32_pack
+#undef wide_u32_srai
+#undef wide_u32_select
+
+#undef wide_u16
+#undef wide_u16_set1
+#undef wide_u16_add
+#undef wide_u16_sub
+#undef wide_u16_mul
+#undef wide_u16_div255
+#undef wide_u16_unpacklo
+#undef wide_u16_unpackhi
+#undef wide_u16_broadcast3
+
+#undef wide_f32
+#undef wide_f32_set1
+#undef wide_f32_loadu
+#undef wide_f32_add
+#undef wide_f32_mul
+#undef wide_f32_div
+#undef wide_f32_min
+#undef wide_f32_max
+
+// NOTE(law): 16-wide AVX-512 kernels. The 16-bit lane operations need the
+// byte/word extension on top of the AVX-512 foundation.
+
+#if _MSC_VER
+#   define KERNEL_TARGET
+#else
+#   define KERNEL_TARGET __attribute__((target("avx512f,avx512bw")))
+#endif
+#define KERNEL_NAME(name) name##_avx512
+#define KERNEL_WIDTH 16
+
+#define wide_u32 __m512i
+#define wide_u32_set1(v) _mm512_set1_epi32(v)
+#define wide_u32_loadu(p) _mm512_loadu_si512((void *)(p))
+#define wide_u32_storeu(p, v) _mm512_storeu_si512((void *)(p), (v))
+#define wide_u32_load(p) _mm512_load_si512((void *)(p))
+#define wide_u32_store(p, v) _mm512_store_si512((void *)(p), (v))
+#define wide_u32_stream(p, v) _mm512_stream_si512((void *)(p), (v))
+#define wide_u32_truncate_f32(v) _mm512_cvttps_epi32(v)
+#define wide_u32_gather(base, indices) _mm512_i32gather_epi32((indices), (void *)(base), 4)
+#define wide_u32_pack(lo, hi) _mm512_packus_epi16((lo), (hi))
+#define wide_u32_srai(v, n) _mm512_srai_epi32((v), (n))
+#define wide_u32_select(mask, a, b) _mm512_ternarylogic_epi32((mask), (a), (b), 0xCA)
+
+#define wide_u16 __m512i
+#define wide_u16_set1(v) _mm512_set1_epi16((short)(v))
+#define wide_u16_add(a, b) _mm512_add_epi16((a), (b))
+#define wide_u16_sub(a, b) _mm512_sub_epi16((a), (b))
+#define wide_u16_mul(a, b) _mm512_mullo_epi16((a), (b))
+#define wide_u16_div255(v) _mm512_srli_epi16(_mm512_mulhi_epu16(_mm512_add_epi16((v), _mm512_set1_epi16(127)), _mm512_set1_epi16((short)0x8081)), 7)
+#define wide_u16_unpacklo(v) _mm512_unpacklo_epi8((v), _mm512_setzero_si512())
+#define wide_u16_unpackhi(v) _mm512_unpackhi_epi8((v), _mm512_setzero_si512())
+#define wide_u16_broadcast3(v) _mm512_shufflehi_epi16(_mm512_shufflelo_epi16((v), 0xFF), 0xFF)
+
+#define wide_f32 __m512
+#define wide_f32_set1(v) _mm512_set1_ps(v)
+#define wide_f32_loadu(p) _mm512_loadu_ps(p)
+#define wide_f32_add(a, b) _mm512_add_ps((a), (b))
+#define wide_f32_mul(a, b) _mm512_mul_ps((a), (b))
+#define wide_f32_div(a, b) _mm512_div_ps((a), (b))
+#define wide_f32_min(a, b) _mm512_min_ps((a), (b))
+#define wide_f32_max(a, b) _mm512_max_ps((a), (b))
+
+#include "renderer_software_kernels.c"
+
+#undef KERNEL_NAME
+#undef KERNEL_TARGET
+#undef KERNEL_WIDTH
+#endif
+
+enum software_kernel
+{
+   SOFTWARE_KERNEL_4X,
+   SOFTWARE_KERNEL_AVX2,
+   SOFTWARE_KERNEL_AVX512,
 
-   f32_4x wide_alpha_modulation          = f32_4x_set1(alpha_modulation);
-   f32_4x wide_alpha_modulation_over_255 = f32_4x_set1(alpha_modulation / 255.0f);
+   SOFTWARE_KERNEL_COUNT,
+};
 
-   for(s32 y = 0; y < destination.height; ++y)
+global char *software_kernel_names[] =
+{
+#if __ARM_NEON
+   "NEON",
+#else
+   "SSE2",
+#endif
+   "AVX2",
+   "AVX-512",
+};
+
+function bool is_software_kernel_supported(enum software_kernel kernel)
+{
+   bool result = false;
+
+   switch(kernel)
    {
-      u32 *source_row = source.memory + (y * source.width);
-      u32 *destination_row = destination.memory + (y * destination.width);
+      case SOFTWARE_KERNEL_4X:
+      {
+         result = true;
+      } break;
+
+#if __ARM_NEON
+      default: break;
 
-      for(s32 x = 0; x < destination.width; x += 4)
+#elif _MSC_VER
+      case SOFTWARE_KERNEL_AVX2:
+      case SOFTWARE_KERNEL_AVX512:
       {
-         u32_4x *source_pixels      = (u32_4x *)(source_row + x);
-         u32_4x *destination_pixels = (u32_4x *)(destination_row + x);
-
-         // TODO(law): Align memory to 16-byte boundary so we don't need unaligned loads.
-         u32_4x source_color      = u32_4x_loadu(source_pixels);
-         u32_4x destination_color = u32_4x_loadu(destination_pixels);
-
-         f32_4x source_r = f32_4x_convert_u32_4x(u32_4x_and(u32_4x_srli(source_color, 16), wide_mask255));
-         f32_4x source_g = f32_4x_convert_u32_4x(u32_4x_and(u32_4x_srli(source_color, 8), wide_mask255));
-         f32_4x source_b = f32_4x_convert_u32_4x(u32_4x_and(source_color, wide_mask255));
-         f32_4x source_a = f32_4x_convert_u32_4x(u32_4x_and(u32_4x_srli(source_color, 24), wide_mask255));
-
-         f32_4x destination_r = f32_4x_convert_u32_4x(u32_4x_and(u32_4x_srli(destination_color, 16), wide_mask255));
-         f32_4x destination_g = f32_4x_convert_u32_4x(u32_4x_and(u32_4x_srli(destination_color, 8), wide_mask255));
-         f32_4x destination_b = f32_4x_convert_u32_4x(u32_4x_and(destination_color, wide_mask255));
-         f32_4x destination_a = f32_4x_convert_u32_4x(u32_4x_and(u32_4x_srli(destination_color, 24), wide_mask255));
-
-         source_r = f32_4x_mul(source_r, wide_alpha_modulation);
-         source_g = f32_4x_mul(source_g, wide_alpha_modulation);
-         source_b = f32_4x_mul(source_b, wide_alpha_modulation);
-
-         f32_4x source_anormal = f32_4x_mul(wide_alpha_modulation_over_255, source_a);
-         f32_4x destination_anormal = f32_4x_mul(wide_one_over_255, destination_a);
-         f32_4x inverse_source_anormal = f32_4x_sub(wide_one, source_anormal);
-
-         f32_4x r = f32_4x_add(f32_4x_mul(inverse_source_anormal, destination_r), source_r);
-         f32_4x g = f32_4x_add(f32_4x_mul(inverse_source_anormal, destination_g), source_g);
-         f32_4x b = f32_4x_add(f32_4x_mul(inverse_source_anormal, destination_b), source_b);
-
-         // NOTE(law): Seems like the a computation doesn't redistribute like
-         // the other channels due to the alpha_modulation.
-
-         f32_4x a = f32_4x_mul(source_anormal, destination_anormal);
-         a = f32_4x_add(a, source_anormal);
-         a = f32_4x_add(a, source_anormal);
-         a = f32_4x_mul(a, wide_255);
-
-         // TODO(law): Confirm that u32_4x_convert_f32_4x will do the appropriate
-         // rounding for us.
-         u32_4x shift_r = u32_4x_slli(u32_4x_convert_f32_4x(r), 16);
-         u32_4x shift_g = u32_4x_slli(u32_4x_convert_f32_4x(g), 8);
-         u32_4x shift_b = u32_4x_convert_f32_4x(b);
-         u32_4x shift_a = u32_4x_slli(u32_4x_convert_f32_4x(a), 24);
-
-         // TODO(law): Align memory to 16-byte boundary so we don't need unaligned stores.
-         u32_4x color = u32_4x_or(u32_4x_or(shift_r, shift_g), u32_4x_or(shift_b, shift_a));
-         u32_4x_storeu(destination_pixels, color);
-      }
+         // NOTE(law): Besides the CPUID feature bits (AVX2, or AVX-512 F and
+         // BW), check that the OS saves the wider registers on context switches
+         // (XMM/YMM state for AVX2, plus the opmask and ZMM state for AVX-512).
+         int info[4];
+         __cpuid(info, 0);
+         if(info[0] < 7)
+         {
+            // NOTE(law): Leaf 7 holds the feature bits, and querying past the
+            // highest supported leaf returns another leaf's data.
+            break;
+         }
+
+         __cpuid(info, 1);
+
+         bool osxsave = (info[2] & (1 << 27)) != 0;
+         u64 xcr0 = (osxsave) ? _xgetbv(0) : 0;
+
+         __cpuidex(info, 7, 0);
+         if(kernel == SOFTWARE_KERNEL_AVX2)
+         {
+            result = ((info[1] & (1 << 5)) != 0) && ((xcr0 & 0x06) == 0x06);
+         }
+         else
+         {
+            u32 avx512 = (1 << 16) | (1 << 30);
+            result = ((info[1] & avx512) == avx512) && ((xcr0 & 0xE6) == 0xE6);
+         }
+      } break;
+
+#else
+      // NOTE(law): The compiler runtime checks OS support for the wider
+      // registers as well as the CPUID feature bits.
+      case SOFTWARE_KERNEL_AVX2:
+      {
+         result = __builtin_cpu_supports("avx2");
+      } break;
+
+      case SOFTWARE_KERNEL_AVX512:
+      {
+         result = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+      } break;
+#endif
+
+      default: break;
    }
 
-   TIMER_END(immediate_screen_bitmap);
+   return(result);
+}
+
+function void set_software_kernel(struct game_renderer *renderer, enum software_kernel kernel)
+{
+   assert(is_software_kernel_supported(kernel));
+
+   // NOTE(law): Rectangles are only ever drawn a few pixels wide, so they stay
+   // scalar regardless of the selected kernel.
+   renderer->rectangle = software_rectangle;
+
+   switch(kernel)
+   {
+#if !__ARM_NEON
+      case SOFTWARE_KERNEL_AVX512:
+      {
+         renderer->clear = software_clear_avx512;
+         renderer->bitmap = software_bitmap_avx512;
+         renderer->screen = software_screen_avx512;
+      } break;
+
+      case SOFTWARE_KERNEL_AVX2:
+      {
+         renderer->clear = software_clear_avx2;
+         renderer->bitmap = software_bitmap_avx2;
+         renderer->screen = software_screen_avx2;
+      } break;
+#endif
+
+      default:
+      {
+         renderer->clear = KERNEL_BASE_NAME(software_clear);
+         renderer->bitmap = KERNEL_BASE_NAME(software_bitmap);
+         renderer->screen = KERNEL_BASE_NAME(software_screen);
+      } break;
+   }
 }
 
-function RENDERER_BITMAP(software_bitmap)
+function enum software_kernel initialize_software_renderer(struct game_renderer *renderer)
 {
-   // NOTE(law): Assuming tile size of 32x32: when aligned to pixel boundaries,
-   // x and y should range from 0 to 31 inclusive. This results in writing 32
-   // pixels per row. When unaligned (say 0.5 to 31.5), the range becomes 0 to
-   // 32 inclusive, i.e. 33 pixels per row.
-
-   s32 minx = floor_s32(posx);
-   s32 miny = floor_s32(posy);
-   s32 maxx = ceiling_s32(posx + (float)(render_width - 1));
-   s32 maxy = ceiling_s32(posy + (float)(render_height - 1));
-
-   if(minx < 0) minx = 0;
-   if(miny < 0) miny = 0;
-   if(maxx >= (s32)destination.width)  maxx = destination.width - 1;
-   if(maxy >= (s32)destination.height) maxy = destination.height - 1;
-
-   for(s32 destinationy = miny; destinationy <= maxy; ++destinationy)
+   // NOTE(law): Pick the widest kernels the CPU supports.
+   enum software_kernel result = SOFTWARE_KERNEL_4X;
+   for(enum software_kernel kernel = SOFTWARE_KERNEL_4X; kernel < SOFTWARE_KERNEL_COUNT; ++kernel)
    {
-      for(s32 destinationx = minx; destinationx <= maxx; ++destinationx)
+      if(is_software_kernel_supported(kernel))
       {
-         s32 x = destinationx - minx;
-         s32 y = destinationy - miny;
-
-         // NOTE(law): The uv values are computed based on how far into the
-         // (hypothetical unclipped) target render area we are. In the case of
-         // an aligned 32x32 tile, they should compute 0/31, 1/31, 2/31,
-         // ... 30/31, 31/31.
-         float u = (float)x / (float)(render_width - 1);
-         float v = (float)y / (float)(render_height - 1);
-
-         if(u < 0.0f) u = 0.0f;
-         if(u > 1.0f) u = 1.0f;
-         if(v < 0.0f) v = 0.0f;
-         if(v > 1.0f) v = 1.0f;
-
-         // NOTE(law): Map u and v into the target bitmap coordinates. Bitmaps
-         // are 18x18, with 16x16 pixels of content surrounded by a 1px
-         // transparent margin. Therefore, u and v of 0.0f should map to 1 and
-         // 1.0f should map to 16.
-         s32 sourcex = 1 + (u32)((u * (source.width - 3)) + 0.5f);
-         s32 sourcey = 1 + (u32)((v * (source.height - 3)) + 0.5f);
-
-         assert(sourcex >= 0 && sourcex < source.width);
-         assert(sourcey >= 0 && sourcey < source.height);
-
-         u32 source_color = source.memory[(sourcey * source.width) + sourcex];
-         float sr = (float)((source_color >> 16) & 0xFF);
-         float sg = (float)((source_color >>  8) & 0xFF);
-         float sb = (float)((source_color >>  0) & 0xFF);
-         float sa = (float)((source_color >> 24) & 0xFF);
-
-         u32 *destination_pixel = destination.memory + (destinationy * destination.width) + destinationx;
-
-         u32 destination_color = *destination_pixel;
-         float dr = (float)((destination_color >> 16) & 0xFF);
-         float dg = (float)((destination_color >>  8) & 0xFF);
-         float db = (float)((destination_color >>  0) & 0xFF);
-         float da = (float)((destination_color >> 24) & 0xFF);
-
-         float sanormal = sa / 255.0f;
-
-         float r = ((1.0f - sanormal) * dr) + sr;
-         float g = ((1.0f - sanormal) * dg) + sg;
-         float b = ((1.0f - sanormal) * db) + sb;
-         float a = ((1.0f - sanormal) * da) + sa;
-
-         u32 color = (((u32)(r + 0.5f) << 16) |
-                      ((u32)(g + 0.5f) << 8) |
-                      ((u32)(b + 0.5f) << 0) |
-                      ((u32)(a + 0.5f) << 24));
-
-         *destination_pixel = color;
+         result = kernel;
       }
    }
+
+   set_software_kernel(renderer, result);
+   platform_log("Software renderer: %s kernels.\n", software_kernel_names[result]);
+
+   return(result);
 }
@@ -0,0 +1,355 @@
+/* /////////////////////////////////////////////////////////////////////////// */
+/* (c) copyright 2023 Lawrence D. Kern /////////////////////////////////////// */
+/* /////////////////////////////////////////////////////////////////////////// */
+
+// NOTE(law): This file is a template for the wide software renderer kernels. It
+// is included once per instruction set by renderer_software.c, after defining:
+//
+//    KERNEL_NAME(name)      Appends the instruction set suffix to a name.
+//    KERNEL_BASE_NAME(name) Names the 4-wide kernel helpers, used for rows that
+//                           don't divide evenly into KERNEL_WIDTH.
+//    KERNEL_TARGET          Function attribute enabling the instruction set.
+//    KERNEL_WIDTH           Number of pixels processed at a time.
+//    wide_u32, wide_u16,    Vector types, with wide_* operations matching the
+//    wide_f32               ones in platform_intrinsics.h.
+//
+// Every width computes exactly what the scalar software_blend and
+// software_modulate reference functions do, so each kernel produces identical
+// pixels and can be swapped freely at runtime. Rows are processed KERNEL_WIDTH
+// pixels at a time, then 4 at a time using the base kernel's helpers, then one
+// at a time where a kernel needs it.
+
+KERNEL_TARGET function KERNEL_INLINE wide_u16 KERNEL_NAME(blend_channels)(wide_u16 source, wide_u16 destination)
+{
+   // NOTE(law): Premultiplied source over destination, for pixels unpacked into
+   // 16-bit lanes. Each channel is source + round(destination * (255 - source
+   // alpha) / 255).
+   wide_u16 inverse_alpha = wide_u16_sub(wide_u16_set1(255), wide_u16_broadcast3(source));
+
+   wide_u16 result = wide_u16_add(source, wide_u16_div255(wide_u16_mul(destination, inverse_alpha)));
+   return(result);
+}
+
+KERNEL_TARGET function KERNEL_INLINE wide_u32 KERNEL_NAME(blend_pixels)(wide_u16 source_lo, wide_u16 source_hi, wide_u32 destination)
+{
+   wide_u16 lo = KERNEL_NAME(blend_channels)(source_lo, wide_u16_unpacklo(destination));
+   wide_u16 hi = KERNEL_NAME(blend_channels)(source_hi, wide_u16_unpackhi(destination));
+
+   wide_u32 result = wide_u32_pack(lo, hi);
+   return(result);
+}
+
+KERNEL_TARGET function KERNEL_INLINE void KERNEL_NAME(composite_pixels)(u32 *destination, wide_u32 source,
+                                                                        enum render_bitmap_opacity opacity)
+{
+   // NOTE(law): Opaque and masked sources give the same result as the blend,
+   // but skip the arithmetic. A masked source pixel either has its alpha high
+   // bit set and replaces the destination, or is zero and leaves it alone.
+   if(opacity == RENDER_BITMAP_OPAQUE)
+   {
+      wide_u32_storeu(destination, source);
+   }
+   else
+   {
+      wide_u32 destination_color = wide_u32_loadu(destination);
+
+      wide_u32 color;
+      if(opacity == RENDER_BITMAP_MASKED)
+      {
+         color = wide_u32_select(wide_u32_srai(source, 31), source, destination_color);
+      }
+      else
+      {
+         color = KERNEL_NAME(blend_pixels)(wide_u16_unpacklo(source), wide_u16_unpackhi(source), destination_color);
+      }
+
+      wide_u32_storeu(destination, color);
+   }
+}
+
+KERNEL_TARGET function KERNEL_INLINE void KERNEL_NAME(clear_pixels)(u32 *destination, u32 color, bool is_streaming)
+{
+   wide_u32 wide_color = wide_u32_set1(color);
+   if(is_streaming)
+   {
+      wide_u32_stream(destination, wide_color);
+   }
+   else
+   {
+      wide_u32_store(destination, wide_color);
+   }
+}
+
+KERNEL_TARGET function KERNEL_INLINE void KERNEL_NAME(copy_pixels)(u32 *destination, u32 *source)
+{
+   wide_u32_store(destination, wide_u32_load(source));
+}
+
+KERNEL_TARGET function KERNEL_INLINE void KERNEL_NAME(screen_pixels)(u32 *destination, u32 *source, u32 modulation)
+{
+   wide_u32 source_color      = wide_u32_load(source);
+   wide_u32 destination_color = wide_u32_load(destination);
+
+   // NOTE(law): Scale every source channel (alpha included) by the modulation,
+   // which keeps the source premultiplied.
+   wide_u16 wide_modulation = wide_u16_set1(modulation);
+   wide_u16 lo = wide_u16_div255(wide_u16_mul(wide_u16_unpacklo(source_color), wide_modulation));
+   wide_u16 hi = wide_u16_div255(wide_u16_mul(wide_u16_unpackhi(source_color), wide_modulation));
+
+   wide_u32 color = KERNEL_NAME(blend_pixels)(lo, hi, destination_color);
+   wide_u32_store(destination, color);
+}
+
+KERNEL_TARGET function KERNEL_INLINE void KERNEL_NAME(bitmap_pixels)(u32 *destination, u32 *source_row, float x,
+                                                                     float width_divisor, float width_scale,
+                                                                     enum render_bitmap_opacity opacity)
+{
+   // NOTE(law): See the scalar loop in software_bitmap for what each step of
+   // the texture mapping is doing.
+   wide_f32 wide_zero = wide_f32_set1(0.0f);
+   wide_f32 wide_half = wide_f32_set1(0.5f);
+   wide_f32 wide_one  = wide_f32_set1(1.0f);
+
+   wide_f32 wide_x = wide_f32_add(wide_f32_set1(x), wide_f32_loadu(software_lane_indices));
+   wide_f32 u = wide_f32_div(wide_x, wide_f32_set1(width_divisor));
+   u = wide_f32_min(wide_f32_max(u, wide_zero), wide_one);
+
+   wide_u32 sourcex = wide_u32_truncate_f32(wide_f32_add(wide_f32_mul(u, wide_f32_set1(width_scale)), wide_half));
+   wide_u32 source_color = wide_u32_gather(source_row + 1, sourcex);
+
+   KERNEL_NAME(composite_pixels)(destination, source_color, opacity);
+}
+
+KERNEL_TARGET function KERNEL_INLINE void KERNEL_NAME(row_pixels)(u32 *destination, u32 *source,
+                                                                  enum render_bitmap_opacity opacity)
+{
+   KERNEL_NAME(composite_pixels)(destination, wide_u32_loadu(source), opacity);
+}
+
+KERNEL_TARGET function RENDERER_CLEAR(KERNEL_NAME(software_clear))
+{
+   // START:   6830424 cycles
+   // CURRENT: 0.45 cycles/pixel (SSE2), 0.43 (AVX2), 0.43 (AVX-512), was
+   //          0.75/0.55/0.55 with unaligned stores (sokoban_headless benchmark)
+   //          0.72/0.59/0.56 streamed, for the 2048x1024 benchmark case
+
+   // NOTE(law): This runs on worker threads, one render tile at a time, so it
+   // isn't timed with the (single-threaded) profiler.
+
+   assert(is_render_bitmap_aligned(destination));
+   assert((clip.minx % 4) == 0 && (clip.maxx % 4) == 0);
+
+   // NOTE(law): Streaming stores don't read each line into the cache first, but
+   // they also leave the pixels in memory rather than in the cache. A render
+   // tile, or even the whole output, is drawn over right after it's cleared and
+   // still fits in cache, and ordinary aligned stores measured faster for both.
+   // Only clears too large to stay cached are streamed.
+   s32 pixel_count = (clip.maxx - clip.minx) * (clip.maxy - clip.miny);
+   bool is_streaming = (pixel_count >= SOFTWARE_STREAMING_CLEAR_PIXELS);
+
+   // NOTE(law): Every row starts aligned, so any 4 pixels at a multiple of 4
+   // are 16-byte aligned. The 4-wide helpers cover the pixels before the first
+   // multiple of KERNEL_WIDTH and after the last one.
+   s32 alignedx = MINIMUM(clip.maxx, (clip.minx + KERNEL_WIDTH - 1) & ~(KERNEL_WIDTH - 1));
+
+   for(s32 y = clip.miny; y < clip.maxy; ++y)
+   {
+      u32 *row = destination.memory + (y * destination.pitch);
+
+      s32 x = clip.minx;
+      for(; x < alignedx; x += 4)
+      {
+         KERNEL_BASE_NAME(clear_pixels)(row + x, color, is_streaming);
+      }
+      for(; x + KERNEL_WIDTH <= clip.maxx; x += KERNEL_WIDTH)
+      {
+         KERNEL_NAME(clear_pixels)(row + x, color, is_streaming);
+      }
+      for(; x < clip.maxx; x += 4)
+      {
+         KERNEL_BASE_NAME(clear_pixels)(row + x, color, is_streaming);
+      }
+   }
+
+   if(is_streaming)
+   {
+      // NOTE(law): Streaming stores are weakly ordered, so make sure they have
+      // landed before the tile is reported finished and read by another thread.
+      stream_fence();
+   }
+}
+
+KERNEL_TARGET function RENDERER_SCREEN(KERNEL_NAME(software_screen))
+{
+   // START:   29638612 cycles
+   // CURRENT: 3.2 cycles/pixel (SSE2), 1.7 (AVX2), 1.2 (AVX-512), was 4.35
+   //          with the float SSE2 blend (sokoban_headless benchmark)
+
+   assert(destination.width == source.width);
+   assert(destination.height == source.height);
+   assert(is_render_bitmap_aligned(destination) && is_render_bitmap_aligned(source));
+   assert((clip.minx % 4) == 0 && (clip.maxx % 4) == 0);
+
+   // NOTE(law): See software_clear for how each row is split up.
+   s32 alignedx = MINIMUM(clip.maxx, (clip.minx + KERNEL_WIDTH - 1) & ~(KERNEL_WIDTH - 1));
+
+   u32 modulation = software_modulation(alpha_modulation);
+
+   if(modulation == 255 && source.opacity == RENDER_BITMAP_OPAQUE)
+   {
+      // NOTE(law): An opaque source at full strength (e.g. the cached level
+      // background) replaces the destination outright.
+      for(s32 y = clip.miny; y < clip.maxy; ++y)
+      {
+         u32 *source_row = source.memory + (y * source.pitch);
+         u32 *destination_row = destination.memory + (y * destination.pitch);
+
+         s32 x = clip.minx;
+         for(; x < alignedx; x += 4)
+         {
+            KERNEL_BASE_NAME(copy_pixels)(destination_row + x, source_row + x);
+         }
+         for(; x + KERNEL_WIDTH <= clip.maxx; x += KERNEL_WIDTH)
+         {
+            KERNEL_NAME(copy_pixels)(destination_row + x, source_row + x);
+         }
+         for(; x < clip.maxx; x += 4)
+         {
+            KERNEL_BASE_NAME(copy_pixels)(destination_row + x, source_row + x);
+         }
+      }
+
+      return;
+   }
+
+   for(s32 y = clip.miny; y < clip.maxy; ++y)
+   {
+      u32 *source_row = source.memory + (y * source.pitch);
+      u32 *destination_row = destination.memory + (y * destination.pitch);
+
+      s32 x = clip.minx;
+      for(; x < alignedx; x += 4)
+      {
+         KERNEL_BASE_NAME(screen_pixels)(destination_row + x, source_row + x, modulation);
+      }
+      for(; x + KERNEL_WIDTH <= clip.maxx; x += KERNEL_WIDTH)
+      {
+         KERNEL_NAME(screen_pixels)(destination_row + x, source_row + x, modulation);
+      }
+      for(; x < clip.maxx; x += 4)
+      {
+         KERNEL_BASE_NAME(screen_pixels)(destination_row + x, source_row + x, modulation);
+      }
+   }
+}
+
+KERNEL_TARGET function RENDERER_BITMAP(KERNEL_NAME(software_bitmap))
+{
+   // START:   40.1 cycles/pixel (sokoban_headless benchmark, aligned tiles)
+   // CURRENT:  0.85 cycles/pixel (SSE2), 0.77 (AVX2), 0.58 (AVX-512)
+   //          Unaligned tiles take the resampling path at 4.5, 2.2 and 2.1.
+   //          Both were 2.6/1.3/1.3 and 7.9/3.9/3.1 before opaque and masked
+   //          tiles skipped the blend.
+
+   // NOTE(law): Assuming tile size of 32x32: when aligned to pixel boundaries,
+   // x and y should range from 0 to 31 inclusive. This results in writing 32
+   // pixels per row. When unaligned (say 0.5 to 31.5), the range becomes 0 to
+   // 32 inclusive, i.e. 33 pixels per row.
+
+   s32 originx = floor_s32(posx);
+   s32 originy = floor_s32(posy);
+   s32 maxx = ceiling_s32(posx + (float)(render_width - 1));
+   s32 maxy = ceiling_s32(posy + (float)(render_height - 1));
+
+   // NOTE(law): Texture coordinates are measured from the unclipped origin, so
+   // that a bitmap split across several clip rectangles lines up exactly.
+   s32 minx = MAXIMUM(originx, clip.minx);
+   s32 miny = MAXIMUM(originy, clip.miny);
+   if(maxx >= clip.maxx) maxx = clip.maxx - 1;
+   if(maxy >= clip.maxy) maxy = clip.maxy - 1;
+
+   // NOTE(law): A bitmap drawn at its own size (less the margin) on a whole
+   // pixel position maps texels 1:1, which is how the pre-scaled tiles from
+   // load_bitmap are normally drawn. Blend its rows straight across.
+   if(render_width == source.width - 2 && render_height == source.height - 2 &&
+      posx == (float)originx && posy == (float)originy)
+   {
+      s32 count = maxx - minx + 1;
+      for(s32 destinationy = miny; destinationy <= maxy; ++destinationy)
+      {
+         u32 *source_row = source.memory + ((destinationy - originy + 1) * source.pitch) + (minx - originx + 1);
+         u32 *destination_row = destination.memory + (destinationy * destination.pitch) + minx;
+
+         s32 x = 0;
+         for(; x + KERNEL_WIDTH <= count; x += KERNEL_WIDTH)
+         {
+            KERNEL_NAME(row_pixels)(destination_row + x, source_row + x, source.opacity);
+         }
+         for(; x + 4 <= count; x += 4)
+         {
+            KERNEL_BASE_NAME(row_pixels)(destination_row + x, source_row + x, source.opacity);
+         }
+         for(; x < count; ++x)
+         {
+            destination_row[x] = software_blend(source_row[x], destination_row[x]);
+         }
+      }
+
+      return;
+   }
+
+   float width_scale = (float)(source.width - 3);
+   float height_scale = (float)(source.height - 3);
+   float width_divisor = (float)(render_width - 1);
+   float height_divisor = (float)(render_height - 1);
+
+   for(s32 destinationy = miny; destinationy <= maxy; ++destinationy)
+   {
+      // NOTE(law): The uv values are computed based on how far into the
+      // (hypothetical unclipped) target render area we are. In the case of
+      // an aligned 32x32 tile, they should compute 0/31, 1/31, 2/31,
+      // ... 30/31, 31/31.
+      s32 y = destinationy - originy;
+      float v = (float)y / height_divisor;
+
+      if(v < 0.0f) v = 0.0f;
+      if(v > 1.0f) v = 1.0f;
+
+      // NOTE(law): Map u and v into the target bitmap coordinates. Bitmaps
+      // are 18x18, with 16x16 pixels of content surrounded by a 1px
+      // transparent margin. Therefore, u and v of 0.0f should map to 1 and
+      // 1.0f should map to 16.
+      s32 sourcey = 1 + (u32)((v * height_scale) + 0.5f);
+      assert(sourcey >= 0 && sourcey < source.height);
+
+      u32 *source_row = source.memory + (sourcey * source.pitch);
+      u32 *destination_row = destination.memory + (destinationy * destination.pitch);
+
+      s32 destinationx = minx;
+      for(; destinationx + KERNEL_WIDTH - 1 <= maxx; destinationx += KERNEL_WIDTH)
+      {
+         KERNEL_NAME(bitmap_pixels)(destination_row + destinationx, source_row, (float)(destinationx - originx),
+                                    width_divisor, width_scale, source.opacity);
+      }
+      for(; destinationx + 3 <= maxx; destinationx += 4)
+      {
+         KERNEL_BASE_NAME(bitmap_pixels)(destination_row + destinationx, source_row, (float)(destinationx - originx),
+                                         width_divisor, width_scale, source.opacity);
+      }
+
+      for(; destinationx <= maxx; ++destinationx)
+      {
+         s32 x = destinationx - originx;
+         float u = (float)x / width_divisor;
+
+         if(u < 0.0f) u = 0.0f;
+         if(u > 1.0f) u = 1.0f;
+
+         s32 sourcex = 1 + (u32)((u * width_scale) + 0.5f);
+         assert(sourcex >= 0 && sourcex < source.width);
+
+         u32 *destination_pixel = destination_row + destinationx;
+         *destination_pixel = software_blend(source_row[sourcex], *destination_pixel);
+      }
+   }
+}
@@ -24,6 +24,22 @@ function void *allocate(struct memory_arena *arena, size_t size)
    return(result);
 }
 
+function void *allocate_aligned(struct memory_arena *arena, size_t size, size_t alignment)
+{
+   // NOTE(law): The alignment must be a power of two. It applies to the
+   // address itself, whatever the alignment of the arena's base.
+   assert((alignment & (alignment - 1)) == 0);
+
+   uintptr_t address = (uintptr_t)(arena->base_address + arena->used);
+   size_t padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+
+   assert((arena->used + padding) <= arena->size);
+   arena->used += padding;
+
+   void *result = allocate(arena, size);
+   return(result);
+}
+
 #include "sokoban_math.c"
 #include "sokoban_random.c"
 #include "sokoban_render.c"
@@ -45,13 +61,21 @@ struct tile_map_state
    u32 player_tiley;
    u32 push_count;
 
-   enum tile_type tiles[SCREEN_TILE_COUNT_Y][SCREEN_TILE_COUNT_X];
+   // NOTE(law): Goals not yet covered by a box. Every function that moves a box
+   // keeps this up to date, so checking for completion doesn't require a scan.
+   u32 open_goal_count;
+
+   // NOTE(law): Tiles hold enum tile_type values, stored as bytes to keep maps
+   // (and every copy of them in replays and saves) small.
+   u8 tiles[SCREEN_TILE_COUNT_Y][SCREEN_TILE_COUNT_X];
 };
 
 struct tile_attributes
 {
-   u32 floor_index;
-   u32 wall_index;
+   // NOTE(law): Indices into the floor_type and wall_type bitmap arrays, packed
+   // into a single byte per tile.
+   u8 floor_index : 4;
+   u8 wall_index : 4;
 };
 
 struct game_level
@@ -59,10 +83,21 @@ struct game_level
    char *name;
    char *file_path;
    struct tile_map_state map;
+   struct tile_map_state initial_map;
    struct tile_attributes attributes[SCREEN_TILE_COUNT_Y][SCREEN_TILE_COUNT_X];
 
    u32 move_count;
    u32 push_count;
+   float seconds_elapsed;
+
+   // NOTE(law): Cached so that drawing the HUD doesn't rehash the map and look
+   // up the progress log every frame. Levels load before the progress database,
+   // so the best counts are filled in on first use.
+   u32 hash;
+   bool is_best_cached;
+   bool has_best;
+   u32 best_move_count;
+   u32 best_push_count;
 };
 
 struct movement_result
@@ -118,11 +153,118 @@ enum wall_type
    WALL_TYPE_COUNT,
 };
 
-#define MAX_UNDO_COUNT 16
+#define UNDO_TREE_MEMORY_BUDGET (4 * 1024 * 1024)
+
+// NOTE(law): The undo tree stores every move made on the current level,
+// including moves that were undone and then branched away from. Each node is
+// one move relative to its parent, so branches share their common prefix and
+// the current map is the only full copy of the level. Nodes live in a pool
+// sized by UNDO_TREE_MEMORY_BUDGET and are linked by index, where 0 is null.
+
+struct undo_node
+{
+   u32 parent;
+   u32 first_child;
+   u32 next_sibling;
+   u32 last_visited;
+
+   // NOTE(law): A move is walk_count walking steps followed by push_count
+   // pushing steps, all in the same direction.
+   u8 direction;
+   u8 walk_count;
+   u8 push_count;
+   u8 reserved;
+};
+
+struct undo_tree
+{
+   u32 node_capacity;
+   struct undo_node *nodes;
+
+   // NOTE(law): Nodes below node_count have been handed out at least once.
+   // Evicted nodes are threaded onto the free list through next_sibling.
+   u32 node_count;
+   u32 first_free;
+   u32 free_count;
+
+   u32 root;
+   u32 current;
+   u32 clock;
+
+   // NOTE(law): The number of LURD steps between the root and current.
+   u32 step_count;
+
+   // NOTE(law): Once the oldest moves on the current path have been evicted,
+   // the root no longer corresponds to the start of the level.
+   bool is_truncated;
+
+   // NOTE(law): The level the moves were recorded on. Only meaningful once
+   // there is a root.
+   u32 level_index;
+};
+
+function void clear_undo_tree(struct undo_tree *tree)
+{
+   tree->node_count = 1;
+   tree->first_free = 0;
+   tree->free_count = 0;
+   tree->root = 0;
+   tree->current = 0;
+   tree->clock = 0;
+   tree->step_count = 0;
+   tree->is_truncated = false;
+}
+
+// NOTE(law): Personal bests are kept in an append-only log. Each completion that
+// improves on a level's record appends a new copy of that record, and an
+// in-memory hash index keyed by level hash points at the latest copy. Stale
+// copies are dropped by compacting the log once they outweigh the live ones.
+
+#define PROGRESS_INDEX_CAPACITY 8192 // NOTE(law): Must be a power of two.
+#define PROGRESS_LOG_CAPACITY (4 * 1024 * 1024)
+#define PROGRESS_COMPACTION_MINIMUM_SIZE (64 * 1024)
+
+struct progress_record
+{
+   u32 level_hash;
+   u32 move_count;
+   u32 push_count;
+   u32 milliseconds;
+
+   // NOTE(law): The LURD solution that achieved move_count, if one is known.
+   u32 solution_length;
+   u8 *solution;
+
+   // NOTE(law): Total size of the record in the log.
+   u32 size;
+};
+
+struct progress_index_entry
+{
+   // NOTE(law): An offset of zero marks an empty slot, since the log always
+   // starts with a file header.
+   u32 level_hash;
+   u32 offset;
+};
+
+struct progress_database
+{
+   u8 *log;
+   size_t log_size;
+   size_t live_size;
+
+   u32 entry_count;
+   struct progress_index_entry *index;
+
+   // NOTE(law): Set when an unreadable file on disk couldn't be backed up. Bests
+   // are then only kept in memory, so the file is never overwritten.
+   bool is_read_only;
+};
 
 struct game_state
 {
    struct memory_arena arena;
+   struct memory_arena frame_arena;
    struct random_entropy entropy;
 
    enum game_menu_state menu_state;
@@ -131,9 +273,8 @@ struct game_state
    u32 level_count;
    struct game_level *levels[64];
 
-   u32 undo_index;
-   u32 undo_count;
-   struct tile_map_state undos[MAX_UNDO_COUNT];
+   struct undo_tree undo_tree;
+   struct progress_database progress;
 
    struct render_bitmap player;
    struct render_bitmap player_on_goal;
@@ -167,6 +308,10 @@ struct game_state
    struct movement_result movement;
    struct render_bitmap snapshot;
 
+   bool is_background_cached;
+   struct render_bitmap background;
+   struct render_bitmap *background_tiles[SCREEN_TILE_COUNT_Y][SCREEN_TILE_COUNT_X];
+
    struct font_glyphs font;
 
    bool is_initialized;
@@ -202,19 +347,54 @@ struct bitmap_header
 };
 #pragma pack(pop)
 
+function enum render_bitmap_opacity get_bitmap_opacity(struct render_bitmap bitmap)
+{
+   // NOTE(law): Classify the pixels the renderer can sample, i.e. everything
+   // inside the 1px margin. Bitmaps are premultiplied, so a masked pixel is
+   // either fully opaque or exactly zero.
+   bool is_opaque = true;
+   bool is_masked = true;
+
+   for(s32 y = 1; y < bitmap.height - 1; ++y)
+   {
+      for(s32 x = 1; x < bitmap.width - 1; ++x)
+      {
+         u32 color = bitmap.memory[(y * bitmap.pitch) + x];
+         u32 alpha = color >> 24;
+
+         is_opaque = is_opaque && (alpha == 0xFF);
+         is_masked = is_masked && (alpha == 0xFF || color == 0);
+      }
+   }
+
+   enum render_bitmap_opacity result = RENDER_BITMAP_TRANSLUCENT;
+   if(is_opaque)
+   {
+      result = RENDER_BITMAP_OPAQUE;
+   }
+   else if(is_masked)
+   {
+      result = RENDER_BITMAP_MASKED;
+   }
+
+   return(result);
+}
+
 function struct render_bitmap generate_null_bitmap(struct memory_arena *arena, u32 width, u32 height)
 {
-   struct render_bitmap result = {width, height};
-   result.memory = allocate(arena, sizeof(u32) * result.width * result.height);
+   struct render_bitmap result = {width, height, width};
+   result.memory = allocate(arena, sizeof(u32) * result.pitch * result.height);
 
    for(s32 y = 0; y < result.height; ++y)
    {
       for(s32 x = 0; x < result.width; ++x)
       {
-         result.memory[(y * result.width) + x] = 0xFFFF00FF;
+         result.memory[(y * result.pitch) + x] = 0xFFFF00FF;
       }
    }
 
+   result.opacity = RENDER_BITMAP_OPAQUE;
+
    return(result);
 }
 
@@ -223,6 +403,47 @@ function struct render_bitmap generate_null_tile(struct memory_arena *arena)
    return generate_null_bitmap(arena, TILE_DIMENSION_PIXELS, TILE_DIMENSION_PIXELS);
 }
 
+function void scale_bitmap(struct render_bitmap destination, struct render_bitmap source)
+{
+   // NOTE(law): Resample source into destination, both with a 1px transparent
+   // margin, using the exact texel mapping of the software renderer's bitmap
+   // function. Drawing destination at its own size (less the margin) then
+   // produces the same pixels as drawing source at that size, at any position,
+   // and whole-pixel positions can be blitted row by row without resampling.
+
+   s32 render_width = destination.width - 2;
+   s32 render_height = destination.height - 2;
+
+   float width_scale = (float)(source.width - 3);
+   float height_scale = (float)(source.height - 3);
+   float width_divisor = (float)(render_width - 1);
+   float height_divisor = (float)(render_height - 1);
+
+   for(s32 y = 0; y < destination.height; ++y)
+   {
+      for(s32 x = 0; x < destination.width; ++x)
+      {
+         u32 color = 0;
+         if(x > 0 && y > 0 && x <= render_width && y <= render_height)
+         {
+            float u = (float)(x - 1) / width_divisor;
+            float v = (float)(y - 1) / height_divisor;
+
+            if(u < 0.0f) u = 0.0f;
+            if(u > 1.0f) u = 1.0f;
+            if(v < 0.0f) v = 0.0f;
+            if(v > 1.0f) v = 1.0f;
+
+            s32 sourcex = 1 + (u32)((u * width_scale) + 0.5f);
+            s32 sourcey = 1 + (u32)((v * height_scale) + 0.5f);
+            color = source.memory[(sourcey * source.pitch) + sourcex];
+         }
+
+         destination.memory[(y * destination.pitch) + x] = color;
+      }
+   }
+}
+
 function struct render_bitmap load_bitmap(struct memory_arena *arena, char *file_path)
 {
    struct render_bitmap result = {0};
@@ -235,9 +456,17 @@ function struct render_bitmap load_bitmap(struct memory_arena *arena, char *file
       assert(header->file_type == 0x4D42); // "BM"
       assert(header->bits_per_pixel == 32);
 
+      // NOTE(law): Tiles are always drawn at TILE_BITMAP_SCALE, so only the
+      // scaled copy is kept. The file is decoded into temporary memory above it.
+      s32 scaled_width = ((header->width - 2) * TILE_BITMAP_SCALE) + 2;
+      s32 scaled_height = ((header->height - 2) * TILE_BITMAP_SCALE) + 2;
+      u32 *scaled_memory = allocate(arena, sizeof(u32) * scaled_width * scaled_height);
+      size_t watermark = arena->used;
+
       result.width = header->width;
       result.height = header->height;
-      result.memory = allocate(arena, sizeof(u32) * result.width * result.height);
+      result.pitch = header->width;
+      result.memory = allocate(arena, sizeof(u32) * result.pitch * result.height);
 
       u32 *source_memory = (u32 *)(file.memory + header->bitmap_offset);
       u32 *row = source_memory + (result.width * (result.height - 1));
@@ -257,7 +486,7 @@ function struct render_bitmap load_bitmap(struct memory_arena *arena, char *file
             g *= anormal;
             b *= anormal;
 
-            result.memory[(y * result.width) + x] = (((u32)(r + 0.5f) << 16) |
+            result.memory[(y * result.pitch) + x] = (((u32)(r + 0.5f) << 16) |
                                                      ((u32)(g + 0.5f) << 8) |
                                                      ((u32)(b + 0.5f) << 0) |
                                                      ((u32)(a + 0.5f) << 24));
@@ -266,6 +495,14 @@ function struct render_bitmap load_bitmap(struct memory_arena *arena, char *file
          row -= result.width;
       }
 
+      struct render_bitmap scaled = {scaled_width, scaled_height, scaled_width};
+      scaled.memory = scaled_memory;
+      scale_bitmap(scaled, result);
+
+      result = scaled;
+      result.opacity = get_bitmap_opacity(result);
+      arena->used = watermark;
+
       platform_free_file(&file);
    }
    else
@@ -279,6 +516,29 @@ function struct render_bitmap load_bitmap(struct memory_arena *arena, char *file
    return(result);
 }
 
+// NOTE(law): Font files were written as a raw copy of struct font_glyphs (on a
+// 64-bit build), before render_bitmap had an opacity field. These structs pin
+// down that layout. The pointers are meaningless on disk.
+struct font_file_glyph
+{
+   s32 width;
+   s32 height;
+   s32 offsetx;
+   s32 offsety;
+   u64 memory;
+};
+
+struct font_file_header
+{
+   float ascent;
+   float descent;
+   float line_gap;
+   u32 padding;
+
+   struct font_file_glyph glyphs[128];
+   u64 pair_distances;
+};
+
 function void load_font(struct font_glyphs *font, struct memory_arena *arena, char *file_path)
 {
    // TODO(law): Better asset packing/unpacking.
@@ -287,17 +547,30 @@ function void load_font(struct font_glyphs *font, struct memory_arena *arena, ch
    // at least at 1x and 2x scale.
 
    // NOTE(law): There's nothing fancy going on with this file format. It's
-   // literally just the font_glyphs struct, followed by the pair_distances
+   // literally just the font_file_header struct, followed by the pair_distances
    // table, and then glyph bitmap memory buffers.
 
    struct platform_file file = platform_load_file(file_path);
    assert(file.memory);
 
    u8 *memory = file.memory;
-   copy_memory(font, memory, sizeof(struct font_glyphs));
-   memory += sizeof(struct font_glyphs);
+   struct font_file_header *header = (struct font_file_header *)memory;
+   memory += sizeof(struct font_file_header);
+
+   font->ascent = header->ascent;
+   font->descent = header->descent;
+   font->line_gap = header->line_gap;
 
    u32 codepoint_count = ARRAY_LENGTH(font->glyphs);
+   for(u32 index = 0; index < codepoint_count; ++index)
+   {
+      struct render_bitmap *glyph = font->glyphs + index;
+      glyph->width = header->glyphs[index].width;
+      glyph->height = header->glyphs[index].height;
+      glyph->pitch = header->glyphs[index].width;
+      glyph->offsetx = header->glyphs[index].offsetx;
+      glyph->offsety = header->glyphs[index].offsety;
+   }
 
    size_t pair_distances_size = codepoint_count * codepoint_count * sizeof(float);
    font->pair_distances = ALLOCATE_SIZE(arena, pair_distances_size);
@@ -314,9 +587,16 @@ function void load_font(struct font_glyphs *font, struct memory_arena *arena, ch
 
       copy_memory(glyph->memory, memory, size);
       memory += size;
+
+      glyph->opacity = get_bitmap_opacity(*glyph);
    }
 
    platform_free_file(&file);
+
+   font->runs = ALLOCATE_TYPE(arena, struct text_run_cache);
+   font->runs->pool = ALLOCATE_SIZE(arena, TEXT_RUN_CACHE_POOL_SIZE * sizeof(u32));
+   font->runs->version = 0;
+   empty_text_run_cache(font->runs);
 }
 
 #pragma pack(push, 1)
@@ -509,6 +789,43 @@ function bool is_tile_character(char c)
    return(result);
 }
 
+function u32 count_open_goals(struct tile_map_state *map)
+{
+   u32 result = 0;
+   for(u32 tiley = 0; tiley < SCREEN_TILE_COUNT_Y; ++tiley)
+   {
+      for(u32 tilex = 0; tilex < SCREEN_TILE_COUNT_X; ++tilex)
+      {
+         enum tile_type type = map->tiles[tiley][tilex];
+         result += (type == TILE_TYPE_GOAL || type == TILE_TYPE_PLAYER_ON_GOAL);
+      }
+   }
+
+   return(result);
+}
+
+function u32 compute_crc32(u8 *memory, size_t size)
+{
+   // NOTE(law): The usual reflected CRC-32 (polynomial 0xEDB88320), computed a
+   // bit at a time. Saves are small enough that a lookup table isn't worth it.
+   u32 result = 0xFFFFFFFF;
+   for(size_t index = 0; index < size; ++index)
+   {
+      result ^= memory[index];
+      for(u32 bit = 0; bit < 8; ++bit)
+      {
+         result = (result >> 1) ^ (0xEDB88320 & (0 - (result & 1)));
+      }
+   }
+   return(~result);
+}
+
+function u32 get_level_hash(struct game_level *level)
+{
+   u32 result = compute_crc32(&level->initial_map.tiles[0][0], sizeof(level->initial_map.tiles));
+   return(result);
+}
+
 function bool load_level(struct game_state *gs, struct game_level *level, char *file_path)
 {
    // NOTE(law): Return whether a valid level was successfully loaded.
@@ -518,8 +835,7 @@ function bool load_level(struct game_state *gs, struct game_level *level, char *
    zero_memory(level, sizeof(*level));
 
    // NOTE(law): Clear undo information
-   gs->undo_index = 0;
-   gs->undo_count = 0;
+   clear_undo_tree(&gs->undo_tree);
 
    u8 tile_characters[SCREEN_TILE_COUNT_X * SCREEN_TILE_COUNT_Y];
    for(u32 index = 0; index < ARRAY_LENGTH(tile_characters); ++index)
@@ -610,6 +926,12 @@ function bool load_level(struct game_state *gs, struct game_level *level, char *
             }
          }
 
+         level->map.open_goal_count = count_open_goals(&level->map);
+
+         // NOTE(law): Keep a pristine copy of the level for saves to diff against.
+         level->initial_map = level->map;
+         level->hash = get_level_hash(level);
+
          // NOTE(law): Handle any post-processing after tiles are read into memory.
          struct random_entropy *entropy = &gs->entropy;
 
@@ -648,53 +970,6 @@ function void store_level(struct game_state *gs, char *path)
    }
 }
 
-function void push_undo(struct game_state *gs)
-{
-   gs->undo_index = (gs->undo_index + 1) % MAX_UNDO_COUNT;
-   gs->undo_count = MINIMUM(gs->undo_count + 1, MAX_UNDO_COUNT);
-
-   struct tile_map_state *undo = gs->undos + gs->undo_index;
-   struct game_level *level = gs->levels[gs->level_index];
-
-   undo->player_tilex = level->map.player_tilex;
-   undo->player_tiley = level->map.player_tiley;
-   undo->push_count = level->push_count;
-
-   for(u32 y = 0; y < SCREEN_TILE_COUNT_Y; ++y)
-   {
-      for(u32 x = 0; x < SCREEN_TILE_COUNT_X; ++x)
-      {
-         undo->tiles[y][x] = level->map.tiles[y][x];
-      }
-   }
-}
-
-function void pop_undo(struct game_state *gs)
-{
-   if(gs->undo_count > 0)
-   {
-      struct tile_map_state *undo = gs->undos + gs->undo_index;
-      struct game_level *level = gs->levels[gs->level_index];
-
-      level->map.player_tilex = undo->player_tilex;
-      level->map.player_tiley = undo->player_tiley;
-
-      for(u32 y = 0; y < SCREEN_TILE_COUNT_Y; ++y)
-      {
-         for(u32 x = 0; x < SCREEN_TILE_COUNT_X; ++x)
-         {
-            level->map.tiles[y][x] = undo->tiles[y][x];
-         }
-      }
-
-      gs->undo_index = (gs->undo_index > 0) ? (gs->undo_index - 1) : MAX_UNDO_COUNT - 1;
-      gs->undo_count--;
-
-      level->move_count--;
-      level->push_count = undo->push_count;
-   }
-}
-
 enum player_direction
 {
    PLAYER_DIRECTION_UP,
@@ -710,323 +985,1925 @@ enum player_movement
    PLAYER_MOVEMENT_CHARGE,
 };
 
-function struct movement_result move_player(struct game_state *gs, enum player_direction direction, enum player_movement movement)
-{
-   // TODO(law): This whole thing can be pared down considerably.
-
-   struct movement_result result = {0};
+// NOTE(law): LURD is the usual plain-text notation for Sokoban solutions: one
+// character per step, lowercase for a walk and uppercase for a push.
 
-   struct game_level *level = gs->levels[gs->level_index];
-   result.initial_player_tilex = result.final_player_tilex = level->map.player_tilex;
-   result.initial_player_tiley = result.final_player_tiley = level->map.player_tiley;
+function char get_lurd_character(enum player_direction direction, bool is_push)
+{
+   static char characters[] = {'u', 'd', 'l', 'r'};
 
-   u32 potential_box_tilex = result.initial_player_tilex;
-   u32 potential_box_tiley = result.initial_player_tiley;
-   while(is_tile_position_in_bounds(potential_box_tilex, potential_box_tiley))
+   char result = characters[direction];
+   if(is_push)
    {
-      enum tile_type type = level->map.tiles[potential_box_tiley][potential_box_tilex];
-      if(type == TILE_TYPE_BOX || type == TILE_TYPE_BOX_ON_GOAL)
-      {
-         break;
-      }
-
-      switch(direction)
-      {
-         case PLAYER_DIRECTION_UP:    {potential_box_tiley--;} break;
-         case PLAYER_DIRECTION_DOWN:  {potential_box_tiley++;} break;
-         case PLAYER_DIRECTION_LEFT:  {potential_box_tilex--;} break;
-         case PLAYER_DIRECTION_RIGHT: {potential_box_tilex++;} break;
-      }
+      result -= ('a' - 'A');
    }
-   result.initial_box_tilex = result.final_box_tilex = potential_box_tilex;
-   result.initial_box_tiley = result.final_box_tiley = potential_box_tiley;
 
-   while(1)
+   return(result);
+}
+
+function bool parse_lurd_character(char c, enum player_direction *direction, bool *is_push)
+{
+   // NOTE(law): Return whether the character was a valid LURD step.
+   bool result = true;
+
+   *is_push = (c >= 'A' && c <= 'Z');
+   switch(c)
    {
-      // NOTE(law): Determine initial player position.
-      u32 ox = level->map.player_tilex;
-      u32 oy = level->map.player_tiley;
+      case 'u': case 'U': {*direction = PLAYER_DIRECTION_UP;} break;
+      case 'd': case 'D': {*direction = PLAYER_DIRECTION_DOWN;} break;
+      case 'l': case 'L': {*direction = PLAYER_DIRECTION_LEFT;} break;
+      case 'r': case 'R': {*direction = PLAYER_DIRECTION_RIGHT;} break;
+      default: {result = false;} break;
+   }
 
-      enum tile_type initial = level->map.tiles[oy][ox];
-      assert(initial == TILE_TYPE_PLAYER || initial == TILE_TYPE_PLAYER_ON_GOAL);
+   return(result);
+}
 
-      // NOTE(law): Calculate potential player destination.
-      u32 px = ox;
-      u32 py = oy;
+function void get_direction_delta(enum player_direction direction, s32 *dx, s32 *dy)
+{
+   *dx = 0;
+   *dy = 0;
 
-      switch(direction)
-      {
-         case PLAYER_DIRECTION_UP:    {py--;} break;
-         case PLAYER_DIRECTION_DOWN:  {py++;} break;
-         case PLAYER_DIRECTION_LEFT:  {px--;} break;
-         case PLAYER_DIRECTION_RIGHT: {px++;} break;
-      }
+   switch(direction)
+   {
+      case PLAYER_DIRECTION_UP:    {*dy = -1;} break;
+      case PLAYER_DIRECTION_DOWN:  {*dy = +1;} break;
+      case PLAYER_DIRECTION_LEFT:  {*dx = -1;} break;
+      case PLAYER_DIRECTION_RIGHT: {*dx = +1;} break;
+   }
+}
 
-      if(is_tile_position_in_bounds(px, py))
-      {
-         enum tile_type d = level->map.tiles[py][px];
-         if(d == TILE_TYPE_FLOOR || d == TILE_TYPE_GOAL)
-         {
-            // NOTE(law): If the player destination tile is unoccupied, move
-            // directly there while accounting for goal vs. floor tiles.
+function bool apply_lurd_step(struct tile_map_state *map, enum player_direction direction, bool is_push)
+{
+   // NOTE(law): Apply a single walk or push to the map, following the same rules
+   // as one step of move_player. Return whether the step was legal, i.e. it
+   // was possible and it pushed a box exactly when is_push says it should. An
+   // illegal step leaves the map untouched.
 
-            push_undo(gs);
+   bool result = false;
 
-            level->map.player_tilex = px;
-            level->map.player_tiley = py;
+   s32 dx;
+   s32 dy;
+   get_direction_delta(direction, &dx, &dy);
 
-            level->map.tiles[oy][ox] = (initial == TILE_TYPE_PLAYER_ON_GOAL) ? TILE_TYPE_GOAL : TILE_TYPE_FLOOR;
-            level->map.tiles[py][px] = (d == TILE_TYPE_GOAL) ? TILE_TYPE_PLAYER_ON_GOAL : TILE_TYPE_PLAYER;
+   u32 x = map->player_tilex;
+   u32 y = map->player_tiley;
 
-            result.final_player_tilex = px;
-            result.final_player_tiley = py;
+   u32 px = x + dx;
+   u32 py = y + dy;
 
-            if(movement == PLAYER_MOVEMENT_DASH || movement == PLAYER_MOVEMENT_CHARGE)
-            {
-               continue;
-            }
-         }
-         else if(d == TILE_TYPE_BOX || d == TILE_TYPE_BOX_ON_GOAL)
+   if(is_tile_position_in_bounds(px, py))
+   {
+      enum tile_type d = map->tiles[py][px];
+      if(d == TILE_TYPE_FLOOR || d == TILE_TYPE_GOAL)
+      {
+         result = !is_push;
+         if(result)
          {
-            // NOTE(law): Calculate potential box destination.
-            u32 bx = px;
-            u32 by = py;
-
-            switch(direction)
-            {
-               case PLAYER_DIRECTION_UP:    {by--;} break;
-               case PLAYER_DIRECTION_DOWN:  {by++;} break;
-               case PLAYER_DIRECTION_LEFT:  {bx--;} break;
-               case PLAYER_DIRECTION_RIGHT: {bx++;} break;
-            }
+            map->tiles[py][px] = (d == TILE_TYPE_GOAL) ? TILE_TYPE_PLAYER_ON_GOAL : TILE_TYPE_PLAYER;
+         }
+      }
+      else if(d == TILE_TYPE_BOX || d == TILE_TYPE_BOX_ON_GOAL)
+      {
+         u32 bx = px + dx;
+         u32 by = py + dy;
 
-            if(is_tile_position_in_bounds(bx, by))
+         if(is_push && is_tile_position_in_bounds(bx, by))
+         {
+            enum tile_type b = map->tiles[by][bx];
+            result = (b == TILE_TYPE_FLOOR || b == TILE_TYPE_GOAL);
+            if(result)
             {
-               // NOTE(law): If the player destination tile is a box that can be
-               // moved, move the box and player accounting for goal vs. floor
-               // tiles.
+               map->tiles[py][px] = (d == TILE_TYPE_BOX_ON_GOAL) ? TILE_TYPE_PLAYER_ON_GOAL : TILE_TYPE_PLAYER;
+               map->tiles[by][bx] = (b == TILE_TYPE_GOAL) ? TILE_TYPE_BOX_ON_GOAL : TILE_TYPE_BOX;
 
-               enum tile_type b = level->map.tiles[by][bx];
-               if(b == TILE_TYPE_FLOOR || b == TILE_TYPE_GOAL)
-               {
-                  if(movement != PLAYER_MOVEMENT_DASH)
-                  {
-                     if((bx != px) || (by != py))
-                     {
-                        level->push_count++;
-                     }
-                     push_undo(gs);
-
-                     level->map.player_tilex = px;
-                     level->map.player_tiley = py;
-
-                     level->map.tiles[oy][ox] = (initial == TILE_TYPE_PLAYER_ON_GOAL) ? TILE_TYPE_GOAL : TILE_TYPE_FLOOR;
-                     level->map.tiles[py][px] = (d == TILE_TYPE_BOX_ON_GOAL) ? TILE_TYPE_PLAYER_ON_GOAL : TILE_TYPE_PLAYER;
-                     level->map.tiles[by][bx] = (b == TILE_TYPE_GOAL) ? TILE_TYPE_BOX_ON_GOAL : TILE_TYPE_BOX;
-
-                     result.final_player_tilex = px;
-                     result.final_player_tiley = py;
-
-                     result.final_box_tilex = bx;
-                     result.final_box_tiley = by;
-
-                     if(movement == PLAYER_MOVEMENT_CHARGE)
-                     {
-                        continue;
-                     }
-                  }
-               }
+               map->open_goal_count += (d == TILE_TYPE_BOX_ON_GOAL);
+               map->open_goal_count -= (b == TILE_TYPE_GOAL);
             }
          }
       }
+   }
 
-      break;
+   if(result)
+   {
+      map->tiles[y][x] = (map->tiles[y][x] == TILE_TYPE_PLAYER_ON_GOAL) ? TILE_TYPE_GOAL : TILE_TYPE_FLOOR;
+      map->player_tilex = px;
+      map->player_tiley = py;
    }
 
-   s32 player_deltax = result.final_player_tilex - result.initial_player_tilex;
-   s32 player_deltay = result.final_player_tiley - result.initial_player_tiley;
+   return(result);
+}
 
-   if(player_deltax < 0) player_deltax *= -1;
-   if(player_deltay < 0) player_deltay *= -1;
+function bool is_lurd_whitespace(char c)
+{
+   bool result = (c == ' ' || c == '\n' || c == '\r' || c == '\t');
+   return(result);
+}
 
-   result.player_tile_delta = player_deltax + player_deltay;
-   level->move_count += result.player_tile_delta;
+function void revert_lurd_step(struct tile_map_state *map, enum player_direction direction, bool is_push)
+{
+   // NOTE(law): Undo a single step that was previously applied to the map. The
+   // player steps back against the direction of travel, and a pushed box is
+   // pulled back along with them.
 
-   s32 box_deltax = result.final_box_tilex - result.initial_box_tilex;
-   s32 box_deltay = result.final_box_tiley - result.initial_box_tiley;
+   s32 dx;
+   s32 dy;
+   get_direction_delta(direction, &dx, &dy);
 
-   if(box_deltax < 0) box_deltax *= -1;
-   if(box_deltay < 0) box_deltay *= -1;
+   u32 x = map->player_tilex;
+   u32 y = map->player_tiley;
 
-   result.box_tile_delta = box_deltax + box_deltay;
+   u32 ox = x - dx;
+   u32 oy = y - dy;
+   assert(is_tile_position_in_bounds(ox, oy));
 
-   return(result);
-}
+   enum tile_type origin = map->tiles[oy][ox];
+   enum tile_type current = map->tiles[y][x];
+   assert(origin == TILE_TYPE_FLOOR || origin == TILE_TYPE_GOAL);
+   assert(current == TILE_TYPE_PLAYER || current == TILE_TYPE_PLAYER_ON_GOAL);
 
-function void snapshot_screen(struct game_state *gs, struct render_bitmap source)
-{
-   assert(source.width == gs->snapshot.width);
-   assert(source.height == gs->snapshot.height);
+   map->tiles[oy][ox] = (origin == TILE_TYPE_GOAL) ? TILE_TYPE_PLAYER_ON_GOAL : TILE_TYPE_PLAYER;
 
-   size_t snapshot_size = source.width * source.height * sizeof(u32);
-   copy_memory(gs->snapshot.memory, source.memory, snapshot_size);
+   if(is_push)
+   {
+      u32 bx = x + dx;
+      u32 by = y + dy;
+      assert(is_tile_position_in_bounds(bx, by));
+
+      enum tile_type box = map->tiles[by][bx];
+      assert(box == TILE_TYPE_BOX || box == TILE_TYPE_BOX_ON_GOAL);
+
+      map->tiles[by][bx] = (box == TILE_TYPE_BOX_ON_GOAL) ? TILE_TYPE_GOAL : TILE_TYPE_FLOOR;
+      map->tiles[y][x] = (current == TILE_TYPE_PLAYER_ON_GOAL) ? TILE_TYPE_BOX_ON_GOAL : TILE_TYPE_BOX;
+
+      map->open_goal_count += (box == TILE_TYPE_BOX_ON_GOAL);
+      map->open_goal_count -= (current == TILE_TYPE_PLAYER_ON_GOAL);
+   }
+   else
+   {
+      map->tiles[y][x] = (current == TILE_TYPE_PLAYER_ON_GOAL) ? TILE_TYPE_GOAL : TILE_TYPE_FLOOR;
+   }
+
+   map->player_tilex = ox;
+   map->player_tiley = oy;
 }
 
-function void begin_animation(struct animation_timer *animation)
+function void initialize_undo_tree(struct undo_tree *tree, struct memory_arena *arena)
 {
-   animation->seconds_remaining = animation->seconds_duration;
+   if(!tree->nodes)
+   {
+      tree->node_capacity = UNDO_TREE_MEMORY_BUDGET / sizeof(struct undo_node);
+      tree->nodes = ALLOCATE_SIZE(arena, tree->node_capacity * sizeof(struct undo_node));
+   }
 }
 
-function void end_animation(struct animation_timer *animation)
+function void unlink_undo_child(struct undo_tree *tree, u32 parent, u32 child)
 {
-   animation->seconds_remaining = 0;
+   u32 *link = &tree->nodes[parent].first_child;
+   while(*link != child)
+   {
+      assert(*link);
+      link = &tree->nodes[*link].next_sibling;
+   }
+   *link = tree->nodes[child].next_sibling;
+   tree->nodes[child].next_sibling = 0;
 }
 
-function bool is_animating(struct animation_timer *animation)
+function void move_undo_child_to_front(struct undo_tree *tree, u32 parent, u32 child)
 {
-   bool result = (animation->seconds_remaining > 0.0f);
-   return(result);
+   // NOTE(law): Children are kept most recently visited first, which makes the
+   // first child the one that redo returns to.
+   if(tree->nodes[parent].first_child != child)
+   {
+      unlink_undo_child(tree, parent, child);
+      tree->nodes[child].next_sibling = tree->nodes[parent].first_child;
+      tree->nodes[parent].first_child = child;
+   }
 }
 
-function bool is_something_animating(struct game_state *gs)
+function u32 get_first_undo_leaf(struct undo_tree *tree, u32 node)
 {
-   bool result = false;
-
-   for(u32 index = 0; index < ARRAY_LENGTH(gs->animations); ++index)
+   while(tree->nodes[node].first_child)
    {
-      struct animation_timer *animation = gs->animations + index;
-      if(is_animating(animation))
-      {
-         result = true;
-         break;
-      }
+      node = tree->nodes[node].first_child;
    }
-
-   return(result);
+   return(node);
 }
 
-function void decrement_animation_timers(struct game_state *gs, float seconds)
+function void free_undo_subtree(struct undo_tree *tree, u32 subtree)
 {
-   for(u32 index = 0; index < ARRAY_LENGTH(gs->animations); ++index)
+   // NOTE(law): Free a subtree that has already been unlinked from its parent,
+   // visiting children before their parents so each next_sibling link is read
+   // before it is reused for the free list.
+
+   u32 node = get_first_undo_leaf(tree, subtree);
+   while(1)
    {
-      struct animation_timer *animation = gs->animations + index;
-      animation->seconds_remaining -= seconds;
+      struct undo_node *undo = tree->nodes + node;
+      u32 parent = undo->parent;
+      u32 sibling = undo->next_sibling;
 
-      if(!is_animating(animation))
+      undo->next_sibling = tree->first_free;
+      tree->first_free = node;
+      tree->free_count++;
+
+      if(node == subtree)
       {
-         end_animation(animation);
+         break;
       }
+
+      node = (sibling) ? get_first_undo_leaf(tree, sibling) : parent;
    }
 }
 
-function bool is_player_moving(struct game_state *gs)
-{
-   bool result = (is_animating(&gs->player_movement) && (gs->movement.player_tile_delta > 0));
-   return(result);
-}
+#define UNDO_EVICTION_BUCKET_COUNT 64
 
-function bool is_any_box_moving(struct game_state *gs)
+function void evict_undo_branches(struct game_state *gs)
 {
-   // NOTE(law): Moving is distinct from animating - a player may have initiated
+   // NOTE(law): Free at least an eighth of the node pool. Branches hanging off
+   // the path from the root to the current move are evicted first, oldest
+   // first, where a branch is as old as its most recently visited node. Ages are
+   // bucketed rather than sorted, so eviction is linear in the size of the tree.
+   // If that still isn't enough, the oldest moves on the current path go next.
+
+   struct undo_tree *tree = &gs->undo_tree;
+   struct undo_node *nodes = tree->nodes;
+   u32 target = tree->node_capacity / 8;
+
+   size_t watermark = gs->arena.used;
+   u32 *ages = ALLOCATE_SIZE(&gs->arena, tree->node_count * sizeof(u32));
+   u32 *sizes = ALLOCATE_SIZE(&gs->arena, tree->node_count * sizeof(u32));
+   bool *is_on_path = ALLOCATE_SIZE(&gs->arena, tree->node_count * sizeof(bool));
+
+   for(u32 index = 0; index < tree->node_count; ++index)
+   {
+      ages[index] = nodes[index].last_visited;
+      sizes[index] = 1;
+      is_on_path[index] = false;
+   }
+
+   // NOTE(law): Record the current path, root first.
+   u32 path_count = 0;
+   for(u32 node = tree->current; node; node = nodes[node].parent)
+   {
+      is_on_path[node] = true;
+      path_count++;
+   }
+
+   u32 *path = ALLOCATE_SIZE(&gs->arena, path_count * sizeof(u32));
+   u32 path_index = path_count;
+   for(u32 node = tree->current; node; node = nodes[node].parent)
+   {
+      path[--path_index] = node;
+   }
+
+   // NOTE(law): Accumulate subtree ages and sizes in post-order.
+   u32 node = get_first_undo_leaf(tree, tree->root);
+   while(node != tree->root)
+   {
+      u32 parent = nodes[node].parent;
+      ages[parent] = MAXIMUM(ages[parent], ages[node]);
+      sizes[parent] += sizes[node];
+
+      u32 sibling = nodes[node].next_sibling;
+      node = (sibling) ? get_first_undo_leaf(tree, sibling) : parent;
+   }
+
+   u32 bucket_sizes[UNDO_EVICTION_BUCKET_COUNT] = {0};
+   for(path_index = 0; path_index < path_count; ++path_index)
+   {
+      for(u32 child = nodes[path[path_index]].first_child; child; child = nodes[child].next_sibling)
+      {
+         if(!is_on_path[child])
+         {
+            u32 bucket = (u32)(((u64)ages[child] * UNDO_EVICTION_BUCKET_COUNT) / ((u64)tree->clock + 1));
+            bucket_sizes[bucket] += sizes[child];
+         }
+      }
+   }
+
+   u32 threshold = 0;
+   u32 evicted_count = 0;
+   while(threshold < UNDO_EVICTION_BUCKET_COUNT - 1 && evicted_count + bucket_sizes[threshold] < target)
+   {
+      evicted_count += bucket_sizes[threshold++];
+   }
+
+   for(path_index = 0; path_index < path_count; ++path_index)
+   {
+      u32 child = nodes[path[path_index]].first_child;
+      while(child)
+      {
+         u32 sibling = nodes[child].next_sibling;
+
+         u32 bucket = (u32)(((u64)ages[child] * UNDO_EVICTION_BUCKET_COUNT) / ((u64)tree->clock + 1));
+         if(!is_on_path[child] && bucket <= threshold)
+         {
+            unlink_undo_child(tree, path[path_index], child);
+            free_undo_subtree(tree, child);
+         }
+
+         child = sibling;
+      }
+   }
+
+   // NOTE(law): Trim the oldest moves from the current path. The next node on
+   // the path becomes the root, and its move can no longer be undone.
+   for(path_index = 0; tree->free_count < target && path_index + 1 < path_count; ++path_index)
+   {
+      u32 old_root = path[path_index];
+      u32 new_root = path[path_index + 1];
+
+      unlink_undo_child(tree, old_root, new_root);
+      free_undo_subtree(tree, old_root);
+
+      nodes[new_root].parent = 0;
+      tree->root = new_root;
+      tree->step_count -= nodes[new_root].walk_count + nodes[new_root].push_count;
+      tree->is_truncated = true;
+   }
+
+   gs->arena.used = watermark;
+}
+
+function u32 allocate_undo_node(struct game_state *gs)
+{
+   struct undo_tree *tree = &gs->undo_tree;
+   if(!tree->first_free && tree->node_count == tree->node_capacity)
+   {
+      evict_undo_branches(gs);
+   }
+
+   u32 result = 0;
+   if(tree->first_free)
+   {
+      result = tree->first_free;
+      tree->first_free = tree->nodes[result].next_sibling;
+      tree->free_count--;
+   }
+   else
+   {
+      assert(tree->node_count < tree->node_capacity);
+      result = tree->node_count++;
+   }
+
+   zero_memory(tree->nodes + result, sizeof(tree->nodes[result]));
+
+   return(result);
+}
+
+function void reset_undo_tree(struct game_state *gs)
+{
+   // NOTE(law): Start the tree over from the current level as it stands. Unless
+   // the level is untouched, its root no longer corresponds to the start.
+   struct undo_tree *tree = &gs->undo_tree;
+   clear_undo_tree(tree);
+
+   tree->level_index = gs->level_index;
+   tree->is_truncated = (gs->levels[gs->level_index]->move_count > 0);
+}
+
+function void discard_stale_undo_tree(struct game_state *gs)
+{
+   // NOTE(law): Undo moves are deltas against the map they were recorded on,
+   // so a tree recorded on another level must never be applied or saved.
+   struct undo_tree *tree = &gs->undo_tree;
+   if(tree->root && tree->level_index != gs->level_index)
+   {
+      platform_log("WARNING: Undo history was recorded on another level, discarding it.\n");
+      reset_undo_tree(gs);
+   }
+}
+
+function void push_undo(struct game_state *gs, enum player_direction direction, u32 walk_count, u32 push_count)
+{
+   // NOTE(law): Record one move, made up of walk_count walking steps followed by
+   // push_count pushing steps. Repeating a move that was previously undone
+   // reuses the existing branch instead of starting a new one.
+
+   struct undo_tree *tree = &gs->undo_tree;
+   initialize_undo_tree(tree, &gs->arena);
+   discard_stale_undo_tree(gs);
+
+   if(!tree->root)
+   {
+      tree->root = tree->current = allocate_undo_node(gs);
+      tree->level_index = gs->level_index;
+   }
+
+   u32 node = tree->nodes[tree->current].first_child;
+   while(node)
+   {
+      struct undo_node *child = tree->nodes + node;
+      if(child->direction == direction && child->walk_count == walk_count && child->push_count == push_count)
+      {
+         move_undo_child_to_front(tree, tree->current, node);
+         break;
+      }
+      node = child->next_sibling;
+   }
+
+   if(!node)
+   {
+      node = allocate_undo_node(gs);
+
+      struct undo_node *undo = tree->nodes + node;
+      undo->parent = tree->current;
+      undo->direction = (u8)direction;
+      undo->walk_count = (u8)walk_count;
+      undo->push_count = (u8)push_count;
+
+      undo->next_sibling = tree->nodes[tree->current].first_child;
+      tree->nodes[tree->current].first_child = node;
+   }
+
+   tree->current = node;
+   tree->nodes[node].last_visited = ++tree->clock;
+   tree->step_count += walk_count + push_count;
+}
+
+function void pop_undo(struct game_state *gs)
+{
+   // NOTE(law): Revert the current move, which may span several steps, and
+   // step back to its parent. The move stays in the tree for redo.
+
+   discard_stale_undo_tree(gs);
+   struct undo_tree *tree = &gs->undo_tree;
+   if(tree->current != tree->root)
+   {
+      struct undo_node *undo = tree->nodes + tree->current;
+      struct game_level *level = gs->levels[gs->level_index];
+
+      for(u32 index = 0; index < undo->push_count; ++index)
+      {
+         revert_lurd_step(&level->map, undo->direction, true);
+      }
+      for(u32 index = 0; index < undo->walk_count; ++index)
+      {
+         revert_lurd_step(&level->map, undo->direction, false);
+      }
+
+      level->move_count -= undo->walk_count + undo->push_count;
+      level->push_count -= undo->push_count;
+      tree->step_count -= undo->walk_count + undo->push_count;
+
+      move_undo_child_to_front(tree, undo->parent, tree->current);
+      tree->current = undo->parent;
+      tree->nodes[tree->current].last_visited = ++tree->clock;
+   }
+}
+
+function void pop_redo(struct game_state *gs)
+{
+   // NOTE(law): Replay the most recently visited move out of the current one.
+
+   discard_stale_undo_tree(gs);
+   struct undo_tree *tree = &gs->undo_tree;
+   u32 node = (tree->current) ? tree->nodes[tree->current].first_child : 0;
+   if(node)
+   {
+      struct undo_node *undo = tree->nodes + node;
+      struct game_level *level = gs->levels[gs->level_index];
+
+      for(u32 index = 0; index < undo->walk_count; ++index)
+      {
+         bool is_valid = apply_lurd_step(&level->map, undo->direction, false);
+         assert(is_valid);
+      }
+      for(u32 index = 0; index < undo->push_count; ++index)
+      {
+         bool is_valid = apply_lurd_step(&level->map, undo->direction, true);
+         assert(is_valid);
+      }
+
+      level->move_count += undo->walk_count + undo->push_count;
+      level->push_count += undo->push_count;
+      tree->step_count += undo->walk_count + undo->push_count;
+
+      tree->current = node;
+      undo->last_visited = ++tree->clock;
+   }
+}
+
+function void copy_undo_path(struct undo_tree *tree, char *destination)
+{
+   // NOTE(law): Write the moves from the root to the current node as a LURD
+   // string of tree->step_count characters.
+
+   char *end = destination + tree->step_count;
+   for(u32 node = tree->current; node != tree->root; node = tree->nodes[node].parent)
+   {
+      struct undo_node *undo = tree->nodes + node;
+      for(u32 index = 0; index < undo->push_count; ++index)
+      {
+         *--end = get_lurd_character(undo->direction, true);
+      }
+      for(u32 index = 0; index < undo->walk_count; ++index)
+      {
+         *--end = get_lurd_character(undo->direction, false);
+      }
+   }
+   assert(end == destination);
+}
+
+function enum tile_type get_underlying_tile(enum tile_type type)
+{
+   // NOTE(law): Return the tile left behind when a player or box moves off.
+   bool is_goal = (type == TILE_TYPE_GOAL || type == TILE_TYPE_PLAYER_ON_GOAL || type == TILE_TYPE_BOX_ON_GOAL);
+
+   enum tile_type result = (is_goal) ? TILE_TYPE_GOAL : TILE_TYPE_FLOOR;
+   return(result);
+}
+
+function bool is_tile_empty(enum tile_type type)
+{
+   bool result = (type == TILE_TYPE_FLOOR || type == TILE_TYPE_GOAL);
+   return(result);
+}
+
+function struct movement_result move_player(struct game_state *gs, enum player_direction direction, enum player_movement movement)
+{
+   // NOTE(law): Every movement type is resolved as a walk of zero or more
+   // steps, optionally followed by a push of zero or more steps. A ray scan
+   // finds where the player stops, then the tiles are updated once and the
+   // whole movement is recorded as a single undo entry.
+
+   struct movement_result result = {0};
+
+   struct game_level *level = gs->levels[gs->level_index];
+   struct tile_map_state *map = &level->map;
+
+   s32 dx;
+   s32 dy;
+   get_direction_delta(direction, &dx, &dy);
+
+   u32 ox = map->player_tilex;
+   u32 oy = map->player_tiley;
+   assert(map->tiles[oy][ox] == TILE_TYPE_PLAYER || map->tiles[oy][ox] == TILE_TYPE_PLAYER_ON_GOAL);
+
+   u32 max_walk_count = (movement == PLAYER_MOVEMENT_WALK) ? 1 : SCREEN_TILE_COUNT_X + SCREEN_TILE_COUNT_Y;
+
+   // NOTE(law): Scan over the empty tiles in front of the player.
+   u32 walk_count = 0;
+   u32 x = ox + dx;
+   u32 y = oy + dy;
+   while(walk_count < max_walk_count && is_tile_position_in_bounds(x, y) && is_tile_empty(map->tiles[y][x]))
+   {
+      walk_count++;
+      x += dx;
+      y += dy;
+   }
+
+   // NOTE(law): If the scan stopped at a box, scan over the empty tiles beyond
+   // it. Walks can only push a box directly in front of the player, dashes
+   // never push, and charges push for as long as the box can move.
+   u32 push_count = 0;
+   bool can_push = (movement == PLAYER_MOVEMENT_CHARGE) || (movement == PLAYER_MOVEMENT_WALK && walk_count == 0);
+   if(can_push && is_tile_position_in_bounds(x, y))
+   {
+      enum tile_type box = map->tiles[y][x];
+      if(box == TILE_TYPE_BOX || box == TILE_TYPE_BOX_ON_GOAL)
+      {
+         u32 max_push_count = (movement == PLAYER_MOVEMENT_WALK) ? 1 : SCREEN_TILE_COUNT_X + SCREEN_TILE_COUNT_Y;
+
+         u32 bx = x + dx;
+         u32 by = y + dy;
+         while(push_count < max_push_count && is_tile_position_in_bounds(bx, by) && is_tile_empty(map->tiles[by][bx]))
+         {
+            push_count++;
+            bx += dx;
+            by += dy;
+         }
+      }
+   }
+
+   u32 step_count = walk_count + push_count;
+
+   u32 px = ox + step_count * dx;
+   u32 py = oy + step_count * dy;
+
+   result.initial_player_tilex = ox;
+   result.initial_player_tiley = oy;
+   result.final_player_tilex = px;
+   result.final_player_tiley = py;
+
+   result.initial_box_tilex = result.final_box_tilex = px;
+   result.initial_box_tiley = result.final_box_tiley = py;
+
+   if(step_count > 0)
+   {
+      map->tiles[oy][ox] = get_underlying_tile(map->tiles[oy][ox]);
+
+      if(push_count > 0)
+      {
+         // NOTE(law): x and y still point at the box's starting position.
+         result.initial_box_tilex = x;
+         result.initial_box_tiley = y;
+         result.final_box_tilex = x + push_count * dx;
+         result.final_box_tiley = y + push_count * dy;
+
+         map->open_goal_count += (map->tiles[y][x] == TILE_TYPE_BOX_ON_GOAL);
+         map->tiles[y][x] = get_underlying_tile(map->tiles[y][x]);
+
+         u32 fbx = result.final_box_tilex;
+         u32 fby = result.final_box_tiley;
+         map->open_goal_count -= (map->tiles[fby][fbx] == TILE_TYPE_GOAL);
+         map->tiles[fby][fbx] = (map->tiles[fby][fbx] == TILE_TYPE_GOAL) ? TILE_TYPE_BOX_ON_GOAL : TILE_TYPE_BOX;
+      }
+
+      map->tiles[py][px] = (map->tiles[py][px] == TILE_TYPE_GOAL) ? TILE_TYPE_PLAYER_ON_GOAL : TILE_TYPE_PLAYER;
+      map->player_tilex = px;
+      map->player_tiley = py;
+
+      push_undo(gs, direction, walk_count, push_count);
+   }
+
+   result.player_tile_delta = step_count;
+   result.box_tile_delta = push_count;
+
+   level->move_count += step_count;
+   level->push_count += push_count;
+
+   return(result);
+}
+
+function bool is_map_complete(struct tile_map_state *map)
+{
+   bool result = (map->open_goal_count == 0);
+   return(result);
+}
+
+struct solution_result
+{
+   bool is_valid;
+   bool is_complete;
+
+   u32 move_count;
+   u32 push_count;
+
+   // NOTE(law): Index of the first illegal character when is_valid is false.
+   size_t failure_index;
+};
+
+function struct solution_result verify_solution(struct tile_map_state *initial_map, char *lurd, size_t length)
+{
+   // NOTE(law): Replay a LURD solution headlessly. This works on a local copy
+   // of the map and skips undo, animation and rendering entirely, so that whole
+   // solution collections can be re-verified quickly.
+
+   struct solution_result result = {0};
+   result.is_valid = true;
+
+   struct tile_map_state map = *initial_map;
+
+   for(size_t index = 0; index < length; ++index)
+   {
+      char c = lurd[index];
+      if(is_lurd_whitespace(c))
+      {
+         continue;
+      }
+
+      enum player_direction direction;
+      bool is_push;
+      if(!parse_lurd_character(c, &direction, &is_push) || !apply_lurd_step(&map, direction, is_push))
+      {
+         result.is_valid = false;
+         result.failure_index = index;
+         break;
+      }
+
+      result.move_count++;
+      result.push_count += is_push;
+   }
+
+   if(result.is_valid)
+   {
+      result.is_complete = is_map_complete(&map);
+   }
+
+   return(result);
+}
+
+// NOTE(law): A replay file stores a LURD solution together with periodic
+// keyframes of the map, so that tooling can jump to any move without simulating
+// from the start of the level. The layout is:
+//
+//    struct replay_header
+//    char moves[move_count]               (LURD, padded to 4-byte alignment)
+//    struct replay_keyframe keyframes[keyframe_count]
+//    struct replay_index_entry index[keyframe_count]
+//    struct replay_footer
+//
+// Keyframe 0 is the initial state of the level, and one more is stored every
+// keyframe_interval moves. Seeking to a move therefore costs a binary search of
+// the index plus at most keyframe_interval steps.
+
+#define SOKOBAN_REPLAY_MAGIC_NUMBER 0x59414C50 // PLAY
+#define SOKOBAN_REPLAY_VERSION 3
+#define REPLAY_KEYFRAME_INTERVAL 1024
+
+struct replay_header
+{
+   u32 magic_number;
+   u32 version;
+   u32 move_count;
+   u32 keyframe_interval;
+};
+
+struct replay_keyframe
+{
+   u32 move_index;
+   u32 push_count;
+   struct tile_map_state map;
+};
+
+struct replay_index_entry
+{
+   u32 move_index;
+   u32 offset;
+};
+
+struct replay_footer
+{
+   u32 index_offset;
+   u32 keyframe_count;
+   u32 magic_number;
+};
+
+struct replay
+{
+   u8 *memory;
+   size_t size;
+
+   u32 move_count;
+   u32 keyframe_interval;
+   u32 keyframe_count;
+
+   char *moves;
+   struct replay_index_entry *index;
+};
+
+function size_t get_replay_moves_size(u32 move_count)
+{
+   // NOTE(law): Pad the move characters so that the keyframes that follow them
+   // stay 4-byte aligned.
+   size_t result = (move_count + 3) & ~3;
+   return(result);
+}
+
+function size_t get_replay_size(u32 move_count, u32 keyframe_interval)
+{
+   u32 keyframe_count = 1 + (move_count / keyframe_interval);
+
+   size_t result = sizeof(struct replay_header) + get_replay_moves_size(move_count);
+   result += keyframe_count * (sizeof(struct replay_keyframe) + sizeof(struct replay_index_entry));
+   result += sizeof(struct replay_footer);
+
+   return(result);
+}
+
+function size_t write_replay(struct tile_map_state *initial_map, char *lurd, size_t length, void *memory, size_t size)
+{
+   // NOTE(law): Write a replay of the LURD solution into memory and return its
+   // size in bytes. Zero is returned if the solution contains an illegal step or
+   // the buffer is too small. Since whitespace is dropped, a buffer of
+   // get_replay_size(length, REPLAY_KEYFRAME_INTERVAL) bytes is always enough.
+
+   size_t result = 0;
+
+   u32 move_count = 0;
+   for(size_t index = 0; index < length; ++index)
+   {
+      move_count += !is_lurd_whitespace(lurd[index]);
+   }
+
+   u32 interval = REPLAY_KEYFRAME_INTERVAL;
+   u32 keyframe_count = 1 + (move_count / interval);
+   if(get_replay_size(move_count, interval) > size)
+   {
+      return(result);
+   }
+
+   u8 *base = (u8 *)memory;
+
+   struct replay_header *header = (struct replay_header *)base;
+   header->magic_number = SOKOBAN_REPLAY_MAGIC_NUMBER;
+   header->version = SOKOBAN_REPLAY_VERSION;
+   header->move_count = move_count;
+   header->keyframe_interval = interval;
+
+   char *moves = (char *)(header + 1);
+   struct replay_keyframe *keyframes = (struct replay_keyframe *)(moves + get_replay_moves_size(move_count));
+   struct replay_index_entry *entries = (struct replay_index_entry *)(keyframes + keyframe_count);
+   struct replay_footer *footer = (struct replay_footer *)(entries + keyframe_count);
+
+   struct tile_map_state map = *initial_map;
+   u32 push_count = 0;
+   u32 move_index = 0;
+   u32 keyframe_index = 0;
+
+   for(size_t index = 0; index <= length; ++index)
+   {
+      if(index < length && is_lurd_whitespace(lurd[index]))
+      {
+         continue;
+      }
+
+      if((move_index % interval) == 0)
+      {
+         struct replay_keyframe *keyframe = keyframes + keyframe_index;
+         keyframe->move_index = move_index;
+         keyframe->push_count = push_count;
+         keyframe->map = map;
+
+         entries[keyframe_index].move_index = move_index;
+         entries[keyframe_index].offset = (u32)((u8 *)keyframe - base);
+
+         keyframe_index++;
+      }
+
+      if(index == length)
+      {
+         break;
+      }
+
+      enum player_direction direction;
+      bool is_push;
+      if(!parse_lurd_character(lurd[index], &direction, &is_push) || !apply_lurd_step(&map, direction, is_push))
+      {
+         return(result);
+      }
+
+      moves[move_index++] = lurd[index];
+      push_count += is_push;
+   }
+
+   assert(keyframe_index == keyframe_count);
+
+   footer->index_offset = (u32)((u8 *)entries - base);
+   footer->keyframe_count = keyframe_count;
+   footer->magic_number = SOKOBAN_REPLAY_MAGIC_NUMBER;
+
+   for(u32 index = move_count; index < get_replay_moves_size(move_count); ++index)
+   {
+      moves[index] = 0;
+   }
+
+   result = (u8 *)(footer + 1) - base;
+
+   return(result);
+}
+
+function bool parse_replay(struct replay *replay, void *memory, size_t size)
+{
+   // NOTE(law): Validate the header, footer and index of a replay file and point
+   // into it. The replay does not own the memory, and nothing is copied.
+
+   bool result = false;
+   zero_memory(replay, sizeof(*replay));
+
+   if(size < sizeof(struct replay_header) + sizeof(struct replay_footer))
+   {
+      return(result);
+   }
+
+   u8 *base = (u8 *)memory;
+   struct replay_header *header = (struct replay_header *)base;
+   struct replay_footer *footer = (struct replay_footer *)(base + size - sizeof(struct replay_footer));
+
+   if(header->magic_number != SOKOBAN_REPLAY_MAGIC_NUMBER ||
+      header->version != SOKOBAN_REPLAY_VERSION ||
+      footer->magic_number != SOKOBAN_REPLAY_MAGIC_NUMBER ||
+      header->keyframe_interval == 0 ||
+      footer->keyframe_count == 0)
+   {
+      return(result);
+   }
+
+   size_t moves_end = sizeof(struct replay_header) + get_replay_moves_size(header->move_count);
+   size_t index_end = footer->index_offset + (size_t)footer->keyframe_count * sizeof(struct replay_index_entry);
+   if(moves_end > size || footer->index_offset < moves_end || index_end > size - sizeof(struct replay_footer))
+   {
+      return(result);
+   }
+
+   struct replay_index_entry *entries = (struct replay_index_entry *)(base + footer->index_offset);
+   for(u32 index = 0; index < footer->keyframe_count; ++index)
+   {
+      struct replay_index_entry *entry = entries + index;
+      bool is_sorted = (index == 0) ? (entry->move_index == 0) : (entry->move_index > entries[index - 1].move_index);
+      if(!is_sorted || entry->move_index > header->move_count ||
+         entry->offset < moves_end || (entry->offset % 4) != 0 ||
+         entry->offset + sizeof(struct replay_keyframe) > size)
+      {
+         return(result);
+      }
+
+      // NOTE(law): Seeking copies the keyframe's map and steps the player from
+      // its stored position, so that position must be in bounds and actually
+      // hold the player.
+      struct replay_keyframe *keyframe = (struct replay_keyframe *)(base + entry->offset);
+      u32 playerx = keyframe->map.player_tilex;
+      u32 playery = keyframe->map.player_tiley;
+      if(keyframe->move_index != entry->move_index || !is_tile_position_in_bounds(playerx, playery))
+      {
+         return(result);
+      }
+
+      u8 player = keyframe->map.tiles[playery][playerx];
+      if(player != TILE_TYPE_PLAYER && player != TILE_TYPE_PLAYER_ON_GOAL)
+      {
+         return(result);
+      }
+   }
+
+   replay->memory = base;
+   replay->size = size;
+   replay->move_count = header->move_count;
+   replay->keyframe_interval = header->keyframe_interval;
+   replay->keyframe_count = footer->keyframe_count;
+   replay->moves = (char *)(header + 1);
+   replay->index = entries;
+
+   result = true;
+
+   return(result);
+}
+
+function struct replay_keyframe *find_replay_keyframe(struct replay *replay, u32 move_index)
+{
+   // NOTE(law): Binary search the index for the last keyframe at or before
+   // move_index. The index always starts at move 0, so one is always found.
+
+   u32 low = 0;
+   u32 high = replay->keyframe_count;
+   while(high - low > 1)
+   {
+      u32 middle = low + (high - low) / 2;
+      if(replay->index[middle].move_index <= move_index)
+      {
+         low = middle;
+      }
+      else
+      {
+         high = middle;
+      }
+   }
+
+   struct replay_keyframe *result = (struct replay_keyframe *)(replay->memory + replay->index[low].offset);
+   return(result);
+}
+
+function bool seek_replay(struct replay *replay, u32 move_index, struct tile_map_state *map, u32 *push_count)
+{
+   // NOTE(law): Reconstruct the map as it was after move_index moves, starting
+   // from the nearest preceding keyframe. Return false if the replay is corrupt,
+   // i.e. one of the stored moves turns out to be illegal.
+
+   bool result = true;
+
+   move_index = MINIMUM(move_index, replay->move_count);
+
+   struct replay_keyframe *keyframe = find_replay_keyframe(replay, move_index);
+   *map = keyframe->map;
+   *push_count = keyframe->push_count;
+
+   for(u32 index = keyframe->move_index; index < move_index; ++index)
+   {
+      enum player_direction direction;
+      bool is_push;
+      if(!parse_lurd_character(replay->moves[index], &direction, &is_push) || !apply_lurd_step(map, direction, is_push))
+      {
+         result = false;
+         break;
+      }
+
+      *push_count += is_push;
+   }
+
+   return(result);
+}
+
+function void snapshot_screen(struct game_state *gs, struct game_renderer *renderer)
+{
+   struct render_bitmap source = renderer->output;
+   assert(source.width == gs->snapshot.width);
+   assert(source.height == gs->snapshot.height);
+   assert(source.pitch == gs->snapshot.pitch);
+
+   size_t snapshot_size = source.pitch * source.height * sizeof(u32);
+   copy_memory(gs->snapshot.memory, source.memory, snapshot_size);
+
+   // NOTE(law): The snapshot is only ever drawn over the whole screen.
+   render_damage(renderer, (struct render_clip){0, 0, source.width, source.height});
+}
+
+function void begin_animation(struct animation_timer *animation)
+{
+   animation->seconds_remaining = animation->seconds_duration;
+}
+
+function void end_animation(struct animation_timer *animation)
+{
+   animation->seconds_remaining = 0;
+}
+
+function bool is_animating(struct animation_timer *animation)
+{
+   bool result = (animation->seconds_remaining > 0.0f);
+   return(result);
+}
+
+function bool is_something_animating(struct game_state *gs)
+{
+   bool result = false;
+
+   for(u32 index = 0; index < ARRAY_LENGTH(gs->animations); ++index)
+   {
+      struct animation_timer *animation = gs->animations + index;
+      if(is_animating(animation))
+      {
+         result = true;
+         break;
+      }
+   }
+
+   return(result);
+}
+
+function void decrement_animation_timers(struct game_state *gs, float seconds)
+{
+   for(u32 index = 0; index < ARRAY_LENGTH(gs->animations); ++index)
+   {
+      struct animation_timer *animation = gs->animations + index;
+      animation->seconds_remaining -= seconds;
+
+      if(!is_animating(animation))
+      {
+         end_animation(animation);
+      }
+   }
+}
+
+function bool is_player_moving(struct game_state *gs)
+{
+   bool result = (is_animating(&gs->player_movement) && (gs->movement.player_tile_delta > 0));
+   return(result);
+}
+
+function bool is_any_box_moving(struct game_state *gs)
+{
+   // NOTE(law): Moving is distinct from animating - a player may have initiated
    // a charge that will move a box, but not yet made contact (i.e. the player
    // has started animating but not the box).
    bool result = (is_animating(&gs->player_movement) && gs->movement.box_tile_delta > 0);
    return(result);
 }
 
-function bool is_this_box_moving(struct game_state *gs, u32 tilex, u32 tiley)
+function bool is_this_box_moving(struct game_state *gs, u32 tilex, u32 tiley)
+{
+   // NOTE(law): Moving is distinct from animating - a player may have initiated
+   // a charge that will move a box, but not yet made contact (i.e. the player
+   // has started animating but not the box).
+   bool result = is_any_box_moving(gs);
+   if(result)
+   {
+      result = (tilex == gs->movement.final_box_tilex && tiley == gs->movement.final_box_tiley);
+   }
+   return(result);
+}
+
+function void begin_level_transition(struct game_state *gs, struct game_renderer *renderer)
+{
+   // NOTE(law): Save the current backbuffer so it can be faded out.
+   snapshot_screen(gs, renderer);
+   begin_animation(&gs->level_transition);
+}
+
+// NOTE(law): The save file is written field by field in little-endian byte
+// order, so that it does not depend on struct layout or padding:
+//
+//    u32 magic_number, version, payload_size, payload_crc
+//    u32 level_index, level_hash, move_count, push_count, milliseconds
+//    u8  player_tilex, player_tiley
+//    u16 tile_delta_count, then per delta: u16 tile_index, u8 tile_type
+//    u8  is_truncated
+//    u32 undo_node_count, current_node_index
+//    per undo node, in preorder: u8 flags_and_direction, walk_count, push_count
+//
+// The CRC covers everything after the header. Tiles are stored as a delta
+// against the level as loaded from disk, and the level is identified by a hash
+// of its pristine tiles so a save is never applied to the wrong level.
+
+#define SOKOBAN_SAVE_MAGIC_NUMBER 0x4F4B4F53 // SOKO
+// NOTE(law): Bump the version whenever the layout or meaning of any field
+// changes, including the width or values of stored tile types, so that older
+// saves are rejected rather than misread.
+#define SOKOBAN_SAVE_VERSION 3
+#define SOKOBAN_SAVE_FILE_PATH "sokoban.save"
+#define SOKOBAN_SAVE_HEADER_SIZE 16
+
+#define UNDO_NODE_HAS_CHILD 0x04
+#define UNDO_NODE_HAS_SIBLING 0x08
+
+struct save_buffer
+{
+   u8 *memory;
+   size_t size;
+   size_t used;
+
+   // NOTE(law): Cleared on any read or write past the end of the buffer.
+   bool is_valid;
+};
+
+function void write_save_u8(struct save_buffer *buffer, u8 value)
+{
+   if(buffer->used + 1 <= buffer->size)
+   {
+      buffer->memory[buffer->used++] = value;
+   }
+   else
+   {
+      buffer->is_valid = false;
+   }
+}
+
+function void write_save_u16(struct save_buffer *buffer, u16 value)
+{
+   write_save_u8(buffer, (u8)(value >> 0));
+   write_save_u8(buffer, (u8)(value >> 8));
+}
+
+function void write_save_u32(struct save_buffer *buffer, u32 value)
+{
+   write_save_u16(buffer, (u16)(value >> 0));
+   write_save_u16(buffer, (u16)(value >> 16));
+}
+
+function u8 read_save_u8(struct save_buffer *buffer)
+{
+   u8 result = 0;
+   if(buffer->used + 1 <= buffer->size)
+   {
+      result = buffer->memory[buffer->used++];
+   }
+   else
+   {
+      buffer->is_valid = false;
+   }
+   return(result);
+}
+
+function u16 read_save_u16(struct save_buffer *buffer)
+{
+   u16 result = read_save_u8(buffer);
+   result |= (u16)read_save_u8(buffer) << 8;
+   return(result);
+}
+
+function u32 read_save_u32(struct save_buffer *buffer)
+{
+   u32 result = read_save_u16(buffer);
+   result |= (u32)read_save_u16(buffer) << 16;
+   return(result);
+}
+
+function void write_undo_tree(struct save_buffer *buffer, struct undo_tree *tree)
+{
+   // NOTE(law): Nodes are written in preorder over their first child and next
+   // sibling links, with one flag for each link, so the tree can be rebuilt
+   // without storing any indices.
+
+   u32 node_count = (tree->root) ? (tree->node_count - 1 - tree->free_count) : 0;
+   size_t count_offset = buffer->used;
+   write_save_u32(buffer, node_count);
+   write_save_u32(buffer, 0);
+
+   u32 current_index = 0;
+   u32 written_count = 0;
+
+   u32 node = tree->root;
+   while(node)
+   {
+      struct undo_node *undo = tree->nodes + node;
+      if(node == tree->current)
+      {
+         current_index = written_count;
+      }
+
+      u8 flags = undo->direction;
+      flags |= (undo->first_child) ? UNDO_NODE_HAS_CHILD : 0;
+      flags |= (node != tree->root && undo->next_sibling) ? UNDO_NODE_HAS_SIBLING : 0;
+
+      write_save_u8(buffer, flags);
+      write_save_u8(buffer, undo->walk_count);
+      write_save_u8(buffer, undo->push_count);
+      written_count++;
+
+      if(undo->first_child)
+      {
+         node = undo->first_child;
+      }
+      else
+      {
+         while(node != tree->root && !tree->nodes[node].next_sibling)
+         {
+            node = tree->nodes[node].parent;
+         }
+         node = (node != tree->root) ? tree->nodes[node].next_sibling : 0;
+      }
+   }
+   assert(written_count == node_count);
+
+   // NOTE(law): Patch in the index of the current node.
+   size_t end = buffer->used;
+   buffer->used = count_offset + sizeof(u32);
+   write_save_u32(buffer, current_index);
+   buffer->used = end;
+}
+
+function bool read_undo_tree(struct save_buffer *buffer, struct undo_tree *tree)
+{
+   // NOTE(law): Rebuild the tree into the front of the node pool, where node
+   // n + 1 is the nth node in preorder. Return false on malformed data.
+
+   clear_undo_tree(tree);
+
+   u32 node_count = read_save_u32(buffer);
+   u32 current_index = read_save_u32(buffer);
+   if(!buffer->is_valid || node_count == 0)
+   {
+      return(buffer->is_valid);
+   }
+
+   if(node_count >= tree->node_capacity || current_index >= node_count ||
+      (buffer->size - buffer->used) / 3 < node_count)
+   {
+      return(false);
+   }
+
+   // NOTE(law): The reserved byte holds each node's flags while the tree is
+   // being rebuilt.
+   u32 previous = 0;
+   for(u32 index = 1; index <= node_count; ++index)
+   {
+      struct undo_node *undo = tree->nodes + index;
+      zero_memory(undo, sizeof(*undo));
+
+      u8 flags = read_save_u8(buffer);
+      undo->direction = flags & 0x03;
+      undo->walk_count = read_save_u8(buffer);
+      undo->push_count = read_save_u8(buffer);
+      undo->reserved = flags;
+
+      if(previous)
+      {
+         // NOTE(law): A node is the first child of the previous node if it has
+         // one, otherwise it is the next sibling of the nearest node on the
+         // way back up that is still expecting one.
+         u32 sibling = previous;
+         if(!(tree->nodes[previous].reserved & UNDO_NODE_HAS_CHILD))
+         {
+            while(sibling && !(tree->nodes[sibling].reserved & UNDO_NODE_HAS_SIBLING))
+            {
+               sibling = tree->nodes[sibling].parent;
+            }
+            if(!sibling)
+            {
+               return(false);
+            }
+
+            tree->nodes[sibling].reserved &= ~UNDO_NODE_HAS_SIBLING;
+            tree->nodes[sibling].next_sibling = index;
+            undo->parent = tree->nodes[sibling].parent;
+         }
+         else
+         {
+            tree->nodes[previous].reserved &= ~UNDO_NODE_HAS_CHILD;
+            tree->nodes[previous].first_child = index;
+            undo->parent = previous;
+         }
+
+         if(!undo->parent)
+         {
+            return(false);
+         }
+      }
+      else if(flags & UNDO_NODE_HAS_SIBLING)
+      {
+         return(false);
+      }
+
+      previous = index;
+   }
+
+   // NOTE(law): Every link flag must have been consumed by exactly one node.
+   for(u32 index = 1; index <= node_count; ++index)
+   {
+      if(tree->nodes[index].reserved & (UNDO_NODE_HAS_CHILD | UNDO_NODE_HAS_SIBLING))
+      {
+         return(false);
+      }
+      tree->nodes[index].reserved = 0;
+   }
+
+   tree->node_count = node_count + 1;
+   tree->root = 1;
+   tree->current = current_index + 1;
+   tree->clock = 1;
+
+   for(u32 node = tree->current; node != tree->root; node = tree->nodes[node].parent)
+   {
+      tree->step_count += tree->nodes[node].walk_count + tree->nodes[node].push_count;
+   }
+
+   return(buffer->is_valid);
+}
+
+function void save_game(struct game_state *gs)
+{
+   discard_stale_undo_tree(gs);
+
+   struct game_level *level = gs->levels[gs->level_index];
+   struct undo_tree *tree = &gs->undo_tree;
+
+   // NOTE(law): The save is built in temporary arena memory. Size it for the
+   // worst case, where every tile differs from the pristine level.
+   size_t watermark = gs->arena.used;
+
+   u32 node_count = (tree->root) ? tree->node_count : 0;
+   size_t size = SOKOBAN_SAVE_HEADER_SIZE + 64 + (3 * SCREEN_TILE_COUNT_X * SCREEN_TILE_COUNT_Y) + (3 * node_count);
+
+   struct save_buffer buffer = {0};
+   buffer.memory = ALLOCATE_SIZE(&gs->arena, size);
+   buffer.size = size;
+   buffer.used = SOKOBAN_SAVE_HEADER_SIZE;
+   buffer.is_valid = true;
+
+   // NOTE(law): Save level state information.
+   write_save_u32(&buffer, gs->level_index);
+   write_save_u32(&buffer, level->hash);
+   write_save_u32(&buffer, level->move_count);
+   write_save_u32(&buffer, level->push_count);
+   write_save_u32(&buffer, (u32)(level->seconds_elapsed * 1000.0f));
+   write_save_u8(&buffer, (u8)level->map.player_tilex);
+   write_save_u8(&buffer, (u8)level->map.player_tiley);
+
+   size_t delta_count_offset = buffer.used;
+   write_save_u16(&buffer, 0);
+
+   u16 delta_count = 0;
+   for(u32 index = 0; index < SCREEN_TILE_COUNT_X * SCREEN_TILE_COUNT_Y; ++index)
+   {
+      u8 tile = (&level->map.tiles[0][0])[index];
+      if(tile != (&level->initial_map.tiles[0][0])[index])
+      {
+         write_save_u16(&buffer, (u16)index);
+         write_save_u8(&buffer, tile);
+         delta_count++;
+      }
+   }
+
+   // NOTE(law): Save undo information.
+   write_save_u8(&buffer, tree->is_truncated);
+   write_undo_tree(&buffer, tree);
+
+   size_t payload_end = buffer.used;
+   buffer.used = delta_count_offset;
+   write_save_u16(&buffer, delta_count);
+
+   size_t payload_size = payload_end - SOKOBAN_SAVE_HEADER_SIZE;
+   buffer.used = 0;
+   write_save_u32(&buffer, SOKOBAN_SAVE_MAGIC_NUMBER);
+   write_save_u32(&buffer, SOKOBAN_SAVE_VERSION);
+   write_save_u32(&buffer, (u32)payload_size);
+   write_save_u32(&buffer, compute_crc32(buffer.memory + SOKOBAN_SAVE_HEADER_SIZE, payload_size));
+
+   assert(buffer.is_valid);
+   platform_queue_save_file(SOKOBAN_SAVE_FILE_PATH, buffer.memory, payload_end);
+
+   gs->arena.used = watermark;
+}
+
+function void load_game(struct game_state *gs)
+{
+   // NOTE(law): The last save_game may still be waiting to be written.
+   platform_flush_file(SOKOBAN_SAVE_FILE_PATH);
+
+   struct platform_file save = platform_load_file(SOKOBAN_SAVE_FILE_PATH);
+   if(save.memory)
+   {
+      struct save_buffer buffer = {0};
+      buffer.memory = save.memory;
+      buffer.size = save.size;
+      buffer.is_valid = true;
+
+      u32 magic_number = read_save_u32(&buffer);
+      u32 version = read_save_u32(&buffer);
+      u32 payload_size = read_save_u32(&buffer);
+      u32 payload_crc = read_save_u32(&buffer);
+
+      if(buffer.is_valid &&
+         magic_number == SOKOBAN_SAVE_MAGIC_NUMBER &&
+         version == SOKOBAN_SAVE_VERSION &&
+         payload_size == save.size - SOKOBAN_SAVE_HEADER_SIZE &&
+         payload_crc == compute_crc32(save.memory + SOKOBAN_SAVE_HEADER_SIZE, payload_size))
+      {
+         u32 level_index = read_save_u32(&buffer);
+         u32 level_hash = read_save_u32(&buffer);
+
+         // NOTE(law): Find the saved level, even if the level list has been
+         // reordered since. If it no longer exists, keep the current level.
+         struct game_level *level = 0;
+         if(level_index < gs->level_count && gs->levels[level_index]->hash == level_hash)
+         {
+            level = gs->levels[level_index];
+         }
+         for(u32 index = 0; !level && index < gs->level_count; ++index)
+         {
+            if(gs->levels[index]->hash == level_hash)
+            {
+               level_index = index;
+               level = gs->levels[index];
+            }
+         }
+
+         if(level)
+         {
+            // NOTE(law): Rebuild into a scratch map, so a malformed save leaves
+            // the current level untouched.
+            struct tile_map_state map = level->initial_map;
+
+            u32 move_count = read_save_u32(&buffer);
+            u32 push_count = read_save_u32(&buffer);
+            u32 milliseconds = read_save_u32(&buffer);
+            map.player_tilex = read_save_u8(&buffer);
+            map.player_tiley = read_save_u8(&buffer);
+
+            u16 delta_count = read_save_u16(&buffer);
+            for(u32 delta_index = 0; delta_index < delta_count && buffer.is_valid; ++delta_index)
+            {
+               u16 tile_index = read_save_u16(&buffer);
+               u8 tile = read_save_u8(&buffer);
+               if(tile_index >= SCREEN_TILE_COUNT_X * SCREEN_TILE_COUNT_Y || tile > TILE_TYPE_GOAL)
+               {
+                  buffer.is_valid = false;
+                  break;
+               }
+               (&map.tiles[0][0])[tile_index] = tile;
+            }
+            map.open_goal_count = count_open_goals(&map);
+
+            bool is_truncated = read_save_u8(&buffer);
+
+            bool is_valid = buffer.is_valid && is_tile_position_in_bounds(map.player_tilex, map.player_tiley);
+            if(is_valid)
+            {
+               enum tile_type player = map.tiles[map.player_tiley][map.player_tilex];
+               is_valid = (player == TILE_TYPE_PLAYER || player == TILE_TYPE_PLAYER_ON_GOAL);
+            }
+
+            // NOTE(law): Load undo information. The tree is also decoded into
+            // scratch memory and only copied over the live one once it has
+            // validated. It can't hold more nodes than the rest of the save.
+            struct undo_tree *tree = &gs->undo_tree;
+            initialize_undo_tree(tree, &gs->arena);
+
+            size_t watermark = gs->arena.used;
+
+            struct undo_tree scratch = {0};
+            scratch.node_capacity = (u32)MINIMUM(tree->node_capacity, (buffer.size - buffer.used) / 3 + 1);
+            scratch.nodes = ALLOCATE_SIZE(&gs->arena, scratch.node_capacity * sizeof(struct undo_node));
+
+            if(is_valid && read_undo_tree(&buffer, &scratch))
+            {
+               u32 node_capacity = tree->node_capacity;
+               struct undo_node *nodes = tree->nodes;
+               copy_memory(nodes + 1, scratch.nodes + 1, (scratch.node_count - 1) * sizeof(struct undo_node));
+
+               *tree = scratch;
+               tree->node_capacity = node_capacity;
+               tree->nodes = nodes;
+               tree->is_truncated = is_truncated;
+               tree->level_index = level_index;
+               gs->arena.used = watermark;
+
+               gs->level_index = level_index;
+               level->map = map;
+               level->move_count = move_count;
+               level->push_count = push_count;
+               level->seconds_elapsed = milliseconds / 1000.0f;
+            }
+            else
+            {
+               gs->arena.used = watermark;
+
+               platform_log("WARNING: Save file is malformed, restarting the level.\n");
+               gs->level_index = level_index;
+               load_level(gs, level, level->file_path);
+            }
+         }
+      }
+      else
+      {
+         platform_log("WARNING: Save file is corrupt or from an incompatible version.\n");
+      }
+
+      platform_free_file(&save);
+   }
+}
+
+#define SOKOBAN_PROGRESS_MAGIC_NUMBER 0x474F5250 // PROG
+#define SOKOBAN_PROGRESS_VERSION 1
+#define SOKOBAN_PROGRESS_FILE_PATH "sokoban.progress"
+#define SOKOBAN_PROGRESS_BACKUP_FILE_PATH "sokoban.progress.bak"
+#define SOKOBAN_PROGRESS_HEADER_SIZE 8
+
+// NOTE(law): Five u32 fields before the solution and a CRC after it.
+#define PROGRESS_RECORD_OVERHEAD 24
+
+function bool read_progress_record(struct progress_database *db, size_t offset, struct progress_record *record)
+{
+   // NOTE(law): Return whether a complete record with a matching CRC starts at
+   // the given offset. Anything else is a torn append or garbage.
+   struct save_buffer buffer = {0};
+   buffer.memory = db->log + offset;
+   buffer.size = db->log_size - offset;
+   buffer.is_valid = true;
+
+   record->level_hash = read_save_u32(&buffer);
+   record->move_count = read_save_u32(&buffer);
+   record->push_count = read_save_u32(&buffer);
+   record->milliseconds = read_save_u32(&buffer);
+   record->solution_length = read_save_u32(&buffer);
+
+   bool result = false;
+   if(buffer.is_valid && record->solution_length <= buffer.size - buffer.used - sizeof(u32))
+   {
+      record->solution = buffer.memory + buffer.used;
+      buffer.used += record->solution_length;
+
+      u32 crc = compute_crc32(buffer.memory, buffer.used);
+      result = (read_save_u32(&buffer) == crc && buffer.is_valid);
+      record->size = (u32)buffer.used;
+   }
+
+   return(result);
+}
+
+function u32 write_progress_record(u8 *memory, struct progress_record *record)
+{
+   struct save_buffer buffer = {0};
+   buffer.memory = memory;
+   buffer.size = PROGRESS_RECORD_OVERHEAD + record->solution_length;
+   buffer.is_valid = true;
+
+   write_save_u32(&buffer, record->level_hash);
+   write_save_u32(&buffer, record->move_count);
+   write_save_u32(&buffer, record->push_count);
+   write_save_u32(&buffer, record->milliseconds);
+   write_save_u32(&buffer, record->solution_length);
+
+   copy_memory(buffer.memory + buffer.used, record->solution, record->solution_length);
+   buffer.used += record->solution_length;
+
+   write_save_u32(&buffer, compute_crc32(buffer.memory, buffer.used));
+   assert(buffer.is_valid && buffer.used == buffer.size);
+
+   u32 result = (u32)buffer.used;
+   return(result);
+}
+
+function struct progress_index_entry *find_progress_entry(struct progress_database *db, u32 level_hash)
+{
+   // NOTE(law): Linear probing. Level hashes are CRCs, so the low bits are
+   // already well distributed. Returns the empty slot the hash would occupy if
+   // it isn't present.
+   u32 mask = PROGRESS_INDEX_CAPACITY - 1;
+   u32 slot = level_hash & mask;
+
+   struct progress_index_entry *result = db->index + slot;
+   while(result->offset && result->level_hash != level_hash)
+   {
+      slot = (slot + 1) & mask;
+      result = db->index + slot;
+   }
+
+   return(result);
+}
+
+function bool index_progress_record(struct progress_database *db, u32 offset, struct progress_record *record)
+{
+   struct progress_index_entry *entry = find_progress_entry(db, record->level_hash);
+   if(entry->offset)
+   {
+      struct progress_record previous;
+      bool is_valid = read_progress_record(db, entry->offset, &previous);
+      assert(is_valid);
+
+      db->live_size -= previous.size;
+   }
+   else
+   {
+      // NOTE(law): Keep the table at most three quarters full so that probes
+      // stay short and always terminate.
+      if(db->entry_count >= (PROGRESS_INDEX_CAPACITY / 4) * 3)
+      {
+         platform_log("WARNING: Progress index is full, skipping level %08x.\n", record->level_hash);
+         return(false);
+      }
+      db->entry_count++;
+   }
+
+   entry->level_hash = record->level_hash;
+   entry->offset = offset;
+   db->live_size += record->size;
+
+   return(true);
+}
+
+function void write_progress_header(struct progress_database *db)
 {
-   // NOTE(law): Moving is distinct from animating - a player may have initiated
-   // a charge that will move a box, but not yet made contact (i.e. the player
-   // has started animating but not the box).
-   bool result = is_any_box_moving(gs);
-   if(result)
+   struct save_buffer buffer = {0};
+   buffer.memory = db->log;
+   buffer.size = SOKOBAN_PROGRESS_HEADER_SIZE;
+   buffer.is_valid = true;
+
+   write_save_u32(&buffer, SOKOBAN_PROGRESS_MAGIC_NUMBER);
+   write_save_u32(&buffer, SOKOBAN_PROGRESS_VERSION);
+   assert(buffer.is_valid);
+}
+
+function void compact_progress_database(struct game_state *gs)
+{
+   // NOTE(law): Rewrite the log with only the latest record for each level,
+   // then replace the file on disk with it.
+   struct progress_database *db = &gs->progress;
+
+   size_t watermark = gs->arena.used;
+   u8 *compacted = ALLOCATE_SIZE(&gs->arena, SOKOBAN_PROGRESS_HEADER_SIZE + db->live_size);
+
+   copy_memory(compacted, db->log, SOKOBAN_PROGRESS_HEADER_SIZE);
+   size_t compacted_size = SOKOBAN_PROGRESS_HEADER_SIZE;
+
+   for(u32 index = 0; index < PROGRESS_INDEX_CAPACITY; ++index)
    {
-      result = (tilex == gs->movement.final_box_tilex && tiley == gs->movement.final_box_tiley);
+      struct progress_index_entry *entry = db->index + index;
+      if(entry->offset)
+      {
+         struct progress_record record;
+         bool is_valid = read_progress_record(db, entry->offset, &record);
+         assert(is_valid);
+
+         copy_memory(compacted + compacted_size, db->log + entry->offset, record.size);
+         entry->offset = (u32)compacted_size;
+         compacted_size += record.size;
+      }
    }
-   return(result);
+   assert(compacted_size == SOKOBAN_PROGRESS_HEADER_SIZE + db->live_size);
+
+   copy_memory(db->log, compacted, compacted_size);
+   db->log_size = compacted_size;
+
+   if(!db->is_read_only)
+   {
+      platform_queue_save_file(SOKOBAN_PROGRESS_FILE_PATH, db->log, db->log_size);
+   }
+
+   gs->arena.used = watermark;
 }
 
-function void begin_level_transition(struct game_state *gs, struct render_bitmap snapshot)
+function bool should_compact_progress(struct progress_database *db)
 {
-   // NOTE(law): Save the current backbuffer so it can be faded out.
-   snapshot_screen(gs, snapshot);
-   begin_animation(&gs->level_transition);
+   size_t dead_size = db->log_size - SOKOBAN_PROGRESS_HEADER_SIZE - db->live_size;
+   bool result = (db->log_size >= PROGRESS_COMPACTION_MINIMUM_SIZE && dead_size > db->live_size);
+   return(result);
 }
 
-#define SOKOBAN_SAVE_MAGIC_NUMBER 0x4F4B4F53 // SOKO
-
-struct save_data
+function void load_progress(struct game_state *gs)
 {
-   u32 magic_number;
+   struct progress_database *db = &gs->progress;
+   db->log = ALLOCATE_SIZE(&gs->arena, PROGRESS_LOG_CAPACITY);
+   db->index = ALLOCATE_SIZE(&gs->arena, PROGRESS_INDEX_CAPACITY * sizeof(struct progress_index_entry));
 
-   u32 level_index;
-   struct game_level level;
+   write_progress_header(db);
+   db->log_size = SOKOBAN_PROGRESS_HEADER_SIZE;
 
-   u32 undo_index;
-   u32 undo_count;
-   struct tile_map_state undos[MAX_UNDO_COUNT];
-};
+   bool needs_rewrite = true;
 
-function void save_game(struct game_state *gs)
+   struct platform_file file = platform_load_file(SOKOBAN_PROGRESS_FILE_PATH);
+   if(file.memory)
+   {
+      struct save_buffer header = {0};
+      header.memory = file.memory;
+      header.size = file.size;
+      header.is_valid = true;
+
+      u32 magic_number = read_save_u32(&header);
+      u32 version = read_save_u32(&header);
+
+      if(header.is_valid &&
+         magic_number == SOKOBAN_PROGRESS_MAGIC_NUMBER &&
+         version == SOKOBAN_PROGRESS_VERSION &&
+         file.size <= PROGRESS_LOG_CAPACITY)
+      {
+         copy_memory(db->log, file.memory, file.size);
+         db->log_size = file.size;
+
+         // NOTE(law): Index every record in order, so later copies replace
+         // earlier ones. Stop at the first record that fails to validate.
+         size_t offset = SOKOBAN_PROGRESS_HEADER_SIZE;
+         struct progress_record record;
+         while(offset < db->log_size && read_progress_record(db, offset, &record))
+         {
+            index_progress_record(db, (u32)offset, &record);
+            offset += record.size;
+         }
+
+         // NOTE(law): Anything past the last valid record is a torn append.
+         // Drop it now, otherwise new records would be appended after it and
+         // become unreachable.
+         needs_rewrite = (offset != db->log_size);
+         if(needs_rewrite)
+         {
+            platform_log("WARNING: Discarding %zu bytes from the end of the progress log.\n", db->log_size - offset);
+            db->log_size = offset;
+         }
+      }
+      else
+      {
+         // NOTE(law): Nothing in the file can be trusted, but keep a copy of it
+         // before starting over. If that fails, leave the file alone rather
+         // than wipe every personal best.
+         platform_log("WARNING: Progress log is corrupt or from an incompatible version, copying it to \"%s\".\n",
+                      SOKOBAN_PROGRESS_BACKUP_FILE_PATH);
+
+         needs_rewrite = platform_save_file(SOKOBAN_PROGRESS_BACKUP_FILE_PATH, file.memory, file.size);
+         db->is_read_only = !needs_rewrite;
+      }
+
+      platform_free_file(&file);
+   }
+
+   if(should_compact_progress(db))
+   {
+      compact_progress_database(gs);
+   }
+   else if(needs_rewrite)
+   {
+      platform_queue_save_file(SOKOBAN_PROGRESS_FILE_PATH, db->log, db->log_size);
+   }
+}
+
+function bool get_level_progress(struct game_state *gs, struct game_level *level, struct progress_record *record)
 {
-   struct save_data data = {0};
+   struct progress_database *db = &gs->progress;
 
-   data.magic_number = SOKOBAN_SAVE_MAGIC_NUMBER;
+   bool result = false;
+   struct progress_index_entry *entry = find_progress_entry(db, level->hash);
+   if(entry->offset)
+   {
+      result = read_progress_record(db, entry->offset, record);
+      assert(result);
+   }
 
-   // NOTE(law): Save level state information.
-   data.level_index = gs->level_index;
-   data.level = *gs->levels[gs->level_index];
+   return(result);
+}
 
-   // NOTE(law): Save undo information.
-   data.undo_index = gs->undo_index;
-   data.undo_count = gs->undo_count;
-   for(u32 index = 0; index < MAX_UNDO_COUNT; ++index)
+function void cache_level_best(struct game_level *level, struct progress_record *record)
+{
+   level->is_best_cached = true;
+   level->has_best = true;
+   level->best_move_count = record->move_count;
+   level->best_push_count = record->push_count;
+}
+
+function bool has_level_best(struct game_state *gs, struct game_level *level)
+{
+   if(!level->is_best_cached)
    {
-      data.undos[index] = gs->undos[index];
+      struct progress_record record;
+      if(get_level_progress(gs, level, &record))
+      {
+         cache_level_best(level, &record);
+      }
+      level->is_best_cached = true;
    }
 
-   platform_save_file("sokoban.save", &data, sizeof(data));
+   bool result = level->has_best;
+   return(result);
 }
 
-function void load_game(struct game_state *gs)
+function void record_progress(struct game_state *gs)
 {
-   struct platform_file save = platform_load_file("sokoban.save");
-   if(save.memory)
+   // NOTE(law): Merge the just-completed level into its personal bests, and
+   // append a new record only if something improved.
+   discard_stale_undo_tree(gs);
+
+   struct progress_database *db = &gs->progress;
+   struct game_level *level = gs->levels[gs->level_index];
+   struct undo_tree *tree = &gs->undo_tree;
+
+   size_t watermark = gs->arena.used;
+
+   struct progress_record record = {0};
+   record.level_hash = level->hash;
+   record.move_count = level->move_count;
+   record.push_count = level->push_count;
+   record.milliseconds = (u32)(level->seconds_elapsed * 1000.0f);
+   if(!tree->is_truncated)
+   {
+      record.solution_length = tree->step_count;
+      record.solution = ALLOCATE_SIZE(&gs->arena, tree->step_count);
+      copy_undo_path(tree, (char *)record.solution);
+   }
+
+   struct progress_record previous;
+   if(get_level_progress(gs, level, &previous))
    {
-      // TODO(law): Add better file format validation.
-      struct save_data *data = (struct save_data *)save.memory;
-      if(data->magic_number == SOKOBAN_SAVE_MAGIC_NUMBER)
+      bool is_better_solution = (record.move_count < previous.move_count ||
+                                 (record.move_count == previous.move_count && record.push_count < previous.push_count));
+
+      bool is_improved = (is_better_solution ||
+                          record.push_count < previous.push_count ||
+                          record.milliseconds < previous.milliseconds);
+
+      if(!is_improved)
+      {
+         gs->arena.used = watermark;
+         return;
+      }
+
+      if(!is_better_solution)
+      {
+         record.move_count = previous.move_count;
+         record.solution_length = previous.solution_length;
+         record.solution = previous.solution;
+      }
+      else if(!record.solution && record.move_count == previous.move_count)
       {
-         gs->level_index = data->level_index;
+         // NOTE(law): The undo history was truncated, so there is no new
+         // solution to store. Keep the previous one while it still achieves
+         // move_count. A lower move_count is recorded without a solution.
+         record.solution_length = previous.solution_length;
+         record.solution = previous.solution;
+      }
+      record.push_count = MINIMUM(record.push_count, previous.push_count);
+      record.milliseconds = MINIMUM(record.milliseconds, previous.milliseconds);
+   }
 
-         struct game_level *level = gs->levels[gs->level_index];
+   size_t record_size = PROGRESS_RECORD_OVERHEAD + record.solution_length;
+   if(db->log_size + record_size > PROGRESS_LOG_CAPACITY)
+   {
+      // NOTE(law): Stale copies can fill the log before they outweigh the live
+      // ones, so compact before giving up. Compaction moves records around, so
+      // first copy out a solution that is still being read from the log.
+      if(record.solution >= db->log && record.solution < db->log + db->log_size)
+      {
+         u8 *solution = ALLOCATE_SIZE(&gs->arena, record.solution_length);
+         copy_memory(solution, record.solution, record.solution_length);
+         record.solution = solution;
+      }
 
-         // NOTE(law): Load level state information.
-         level->map = data->level.map;
-         level->move_count = data->level.move_count;
-         level->push_count = data->level.push_count;
+      compact_progress_database(gs);
+   }
 
-         // NOTE(law): Load undo information.
-         gs->undo_index = data->undo_index;
-         gs->undo_count = data->undo_count;
-         for(u32 index = 0; index < ARRAY_LENGTH(gs->undos); ++index)
-         {
-            gs->undos[index] = data->undos[index];
-         }
+   if(db->log_size + record_size > PROGRESS_LOG_CAPACITY)
+   {
+      platform_log("WARNING: Progress log is full, skipping \"%s\".\n", level->name);
+      gs->arena.used = watermark;
+      return;
+   }
+
+   u32 offset = (u32)db->log_size;
+   record.size = write_progress_record(db->log + offset, &record);
+
+   if(index_progress_record(db, offset, &record))
+   {
+      db->log_size += record.size;
+      if(!db->is_read_only)
+      {
+         platform_queue_append_file(SOKOBAN_PROGRESS_FILE_PATH, db->log + offset, record.size);
       }
+      cache_level_best(level, &record);
 
-      platform_free_file(&save);
+      if(should_compact_progress(db))
+      {
+         compact_progress_database(gs);
+      }
    }
+
+   gs->arena.used = watermark;
 }
 
-function struct game_level *set_level(struct game_state *gs, struct render_bitmap snapshot, u32 index)
+function struct game_level *set_level(struct game_state *gs, struct game_renderer *renderer, u32 index)
 {
    // NOTE(law): Update the current level specified in gs.
    gs->level_index = index;
    struct game_level *level = gs->levels[gs->level_index];
 
-   begin_level_transition(gs, snapshot);
+   begin_level_transition(gs, renderer);
 
    // NOTE(law): Clear any state that is invalidated by a level transition.
    end_animation(&gs->player_movement);
@@ -1044,21 +2921,111 @@ function struct game_level *set_level(struct game_state *gs, struct render_bitma
    return(level);
 }
 
-function struct game_level *next_level(struct game_state *gs, struct render_bitmap snapshot)
+function struct game_level *next_level(struct game_state *gs, struct game_renderer *renderer)
 {
    gs->level_index = (gs->level_index + 1) % gs->level_count;
-   return set_level(gs, snapshot, gs->level_index);
+   return set_level(gs, renderer, gs->level_index);
 }
 
-function struct game_level *previous_level(struct game_state *gs, struct render_bitmap snapshot)
+function struct game_level *previous_level(struct game_state *gs, struct game_renderer *renderer)
 {
    gs->level_index = (gs->level_index > 0) ? gs->level_index - 1 : gs->level_count - 1;
-   return set_level(gs, snapshot, gs->level_index);
+   return set_level(gs, renderer, gs->level_index);
+}
+
+function void reload_level(struct game_state *gs, struct game_renderer *renderer)
+{
+   set_level(gs, renderer, gs->level_index);
+}
+
+function void select_level(struct game_state *gs, u32 index)
+{
+   // NOTE(law): Switch to another level as it was left, without reloading it.
+   // Undo moves are deltas against the map they were recorded on, so the undo
+   // tree is started over along with any movement still in flight on the old
+   // level.
+   gs->level_index = index;
+   reset_undo_tree(gs);
+
+   end_animation(&gs->player_movement);
+   zero_memory(&gs->movement, sizeof(gs->movement));
+}
+
+function void get_solution_path(struct game_level *level, char *buffer, size_t size)
+{
+   // NOTE(law): Solutions are stored next to the executable, named after the
+   // level with the .sok extension swapped for .lurd.
+   int stem_length = 0;
+   for(char *scan = level->name; *scan && *scan != '.'; ++scan)
+   {
+      stem_length++;
+   }
+
+   snprintf(buffer, size, "%.*s.lurd", stem_length, level->name);
+}
+
+function void export_solution(struct game_state *gs)
+{
+   discard_stale_undo_tree(gs);
+
+   struct game_level *level = gs->levels[gs->level_index];
+
+   char path[256];
+   get_solution_path(level, path, sizeof(path));
+
+   struct undo_tree *tree = &gs->undo_tree;
+   if(tree->is_truncated)
+   {
+      platform_log("WARNING: Undo history no longer reaches the start of the level, skipping \"%s\".\n", path);
+      return;
+   }
+
+   size_t watermark = gs->arena.used;
+
+   char *solution = ALLOCATE_SIZE(&gs->arena, tree->step_count);
+   copy_undo_path(tree, solution);
+   platform_queue_save_file(path, solution, tree->step_count);
+
+   gs->arena.used = watermark;
 }
 
-function void reload_level(struct game_state *gs, struct render_bitmap snapshot)
+function void import_solution(struct game_state *gs)
 {
-   set_level(gs, snapshot, gs->level_index);
+   // NOTE(law): Restart the current level and feed the stored solution through
+   // move_player one step at a time, stopping at the first step that doesn't
+   // play out the way the solution says it should.
+
+   struct game_level *level = gs->levels[gs->level_index];
+
+   char path[256];
+   get_solution_path(level, path, sizeof(path));
+
+   platform_flush_file(path);
+   struct platform_file file = platform_load_file(path);
+   if(file.size > 0)
+   {
+      load_level(gs, level, level->file_path);
+
+      end_animation(&gs->player_movement);
+      zero_memory(&gs->movement, sizeof(gs->movement));
+
+      for(size_t index = 0; index < file.size; ++index)
+      {
+         enum player_direction direction;
+         bool is_push;
+         if(parse_lurd_character(file.memory[index], &direction, &is_push))
+         {
+            struct movement_result movement = move_player(gs, direction, PLAYER_MOVEMENT_WALK);
+            if(movement.player_tile_delta == 0 || (movement.box_tile_delta > 0) != is_push)
+            {
+               platform_log("WARNING: Solution \"%s\" diverges at step %zu.\n", path, index);
+               break;
+            }
+         }
+      }
+
+      platform_free_file(&file);
+   }
 }
 
 function bool is_level_complete(struct game_state *gs)
@@ -1069,106 +3036,169 @@ function bool is_level_complete(struct game_state *gs)
    }
 
    struct game_level *level = gs->levels[gs->level_index];
-   for(u32 tiley = 0; tiley < SCREEN_TILE_COUNT_Y; ++tiley)
+   bool result = is_map_complete(&level->map);
+
+   return(result);
+}
+
+function struct render_bitmap *get_background_tile_bitmap(struct game_state *gs, struct game_level *level,
+                                                          u32 tilex, u32 tiley)
+{
+   // NOTE(law): Return the static art drawn at a tile, or 0 if there is none.
+   // Boxes that are currently moving are drawn by the second render pass.
+   struct render_bitmap *result = 0;
+
+   struct tile_attributes attributes = level->attributes[tiley][tilex];
+   enum tile_type type = level->map.tiles[tiley][tilex];
+   switch(type)
    {
-      for(u32 tilex = 0; tilex < SCREEN_TILE_COUNT_X; ++tilex)
+      case TILE_TYPE_BOX:
       {
-         enum tile_type type = level->map.tiles[tiley][tilex];
-         if(type == TILE_TYPE_PLAYER_ON_GOAL || type == TILE_TYPE_GOAL)
+         if(!is_this_box_moving(gs, tilex, tiley))
          {
-            return(false);
+            result = &gs->box;
          }
-      }
+      } break;
+
+      case TILE_TYPE_BOX_ON_GOAL:
+      {
+         if(!is_this_box_moving(gs, tilex, tiley))
+         {
+            result = &gs->box_on_goal;
+         }
+         else
+         {
+            result = &gs->goal;
+         }
+      } break;
+
+      case TILE_TYPE_WALL:
+      {
+         result = gs->wall + attributes.wall_index;
+      } break;
+
+      case TILE_TYPE_GOAL:
+      case TILE_TYPE_PLAYER_ON_GOAL:
+      {
+         result = &gs->goal;
+      } break;
+
+      default:
+      {
+         // NOTE(law): We don't handle every type here.
+      } break;
    }
 
-   return(true);
+   return(result);
 }
 
-function void render_push_background(struct game_state *gs, struct game_renderer *renderer, struct platform_work_queue *queue)
+function void draw_background(struct game_state *gs, struct game_renderer *renderer, struct render_clip clip)
 {
-   TIMER_BEGIN(render_push_background);
+   // NOTE(law): Rasterize the part of the background cache inside clip, in the
+   // same order the entries used to be pushed each frame.
+   struct render_bitmap background = gs->background;
 
-   struct render_queue *fg = renderer->queue + RENDER_LAYER_FOREGROUND;
-   struct render_queue *bg = renderer->queue + RENDER_LAYER_BACKGROUND;
+   renderer->clear(background, clip, 0xFF222034);
 
-   render_push_clear(bg, 0xFF222034);
+   // NOTE(law): Each part of a grass blade is one source pixel.
+   float pixel = (float)TILE_BITMAP_SCALE;
 
-   // NOTE(law): First render pass for non-animating objects.
    for(u32 index = 0; index < gs->grass_positions.count; ++index)
    {
-      // TODO(law): Stop hard-coding pixel dimensions!
+      // NOTE(law): Skip blades that lie entirely outside clip, since redrawing
+      // a single tile would otherwise visit every blade on screen.
+      v2 min = gs->grass_positions.samples[index];
+      if(min.x - pixel >= clip.maxx || min.x + (2 * pixel) <= clip.minx || min.y - pixel >= clip.maxy || min.y + pixel <= clip.miny)
+      {
+         continue;
+      }
 
       // Center:
-      v2 min = gs->grass_positions.samples[index];
-      v2 max = {min.x + 1, min.y + 1};
-      render_push_rectangle(bg, min, max, 0xFF3F3F74);
+      v2 max = {min.x + pixel - 1, min.y + pixel - 1};
+      renderer->rectangle(background, clip, min, max, 0xFF3F3F74);
 
       // Left blade:
-      min = (v2){min.x - 2, min.y - 2};
-      max = (v2){min.x + 1, min.y + 1};
-      render_push_rectangle(bg, min, max, 0xFF3F3F74);
+      min = (v2){min.x - pixel, min.y - pixel};
+      max = (v2){min.x + pixel - 1, min.y + pixel - 1};
+      renderer->rectangle(background, clip, min, max, 0xFF3F3F74);
 
       // Right blade:
-      min = (v2){min.x + 4, min.y};
-      max = (v2){min.x + 1, min.y + 1};
-      render_push_rectangle(bg, min, max, 0xFF3F3F74);
+      min = (v2){min.x + (2 * pixel), min.y};
+      max = (v2){min.x + pixel - 1, min.y + pixel - 1};
+      renderer->rectangle(background, clip, min, max, 0xFF3F3F74);
    }
 
-   struct game_level *level = gs->levels[gs->level_index];
+   u32 mintilex = clip.minx / TILE_DIMENSION_PIXELS;
+   u32 mintiley = clip.miny / TILE_DIMENSION_PIXELS;
+   u32 maxtilex = MINIMUM(SCREEN_TILE_COUNT_X, (clip.maxx + TILE_DIMENSION_PIXELS - 1) / TILE_DIMENSION_PIXELS);
+   u32 maxtiley = MINIMUM(SCREEN_TILE_COUNT_Y, (clip.maxy + TILE_DIMENSION_PIXELS - 1) / TILE_DIMENSION_PIXELS);
 
-   for(u32 tiley = 0; tiley < SCREEN_TILE_COUNT_Y; ++tiley)
+   for(u32 tiley = mintiley; tiley < maxtiley; ++tiley)
    {
-      for(u32 tilex = 0; tilex < SCREEN_TILE_COUNT_X; ++tilex)
+      for(u32 tilex = mintilex; tilex < maxtilex; ++tilex)
       {
-         float x = (float)tilex * TILE_DIMENSION_PIXELS;
-         float y = (float)tiley * TILE_DIMENSION_PIXELS;
+         struct render_bitmap *bitmap = gs->background_tiles[tiley][tilex];
+         if(bitmap)
+         {
+            float x = (float)tilex * TILE_DIMENSION_PIXELS;
+            float y = (float)tiley * TILE_DIMENSION_PIXELS;
+            renderer->bitmap(background, clip, *bitmap, x, y, TILE_DIMENSION_PIXELS, TILE_DIMENSION_PIXELS);
+         }
+      }
+   }
 
-         // TODO(law): Avoid drawing the floor in cases where it will be
-         // occluded anyway.
+   // NOTE(law): The cache is drawn to the output at the same position.
+   render_damage(renderer, clip);
+}
 
-         struct tile_attributes attributes = level->attributes[tiley][tilex];
-         enum tile_type type = level->map.tiles[tiley][tilex];
-         switch(type)
-         {
-            case TILE_TYPE_BOX:
-            {
-               if(!is_this_box_moving(gs, tilex, tiley))
-               {
-                  render_push_tile(bg, gs->box, x, y);
-               }
-            } break;
+function void render_push_background(struct game_state *gs, struct game_renderer *renderer, struct platform_work_queue *queue)
+{
+   // START:   2.1M cycles/frame in render (sokoban_headless playback, 1 core)
+   // CURRENT: 1.5M cycles/frame in render when every tile is redrawn, nearly
+   //          all of it copying the cache to the output
 
-            case TILE_TYPE_BOX_ON_GOAL:
-            {
-               if(!is_this_box_moving(gs, tilex, tiley))
-               {
-                  render_push_tile(bg, gs->box_on_goal, x, y);
-               }
-               else
-               {
-                  render_push_tile(bg, gs->goal, x, y);
-               }
-            } break;
+   // NOTE(law): The clear, grass and static tiles only change when the map does,
+   // so they are kept rasterized in gs->background and copied to the output
+   // each frame. Tiles whose art changed since the last frame are redrawn into
+   // the cache on their own, and everything is redrawn the first time through.
 
-            case TILE_TYPE_WALL:
-            {
-               render_push_tile(bg, gs->wall[attributes.wall_index], x, y);
-            } break;
+   TIMER_BEGIN(render_push_background);
 
-            case TILE_TYPE_GOAL:
-            case TILE_TYPE_PLAYER_ON_GOAL:
-            {
-               render_push_tile(bg, gs->goal, x, y);
-            } break;
+   struct render_queue *bg = renderer->queue + RENDER_LAYER_BACKGROUND;
+   struct game_level *level = gs->levels[gs->level_index];
 
-            default:
+   for(u32 tiley = 0; tiley < SCREEN_TILE_COUNT_Y; ++tiley)
+   {
+      for(u32 tilex = 0; tilex < SCREEN_TILE_COUNT_X; ++tilex)
+      {
+         struct render_bitmap *bitmap = get_background_tile_bitmap(gs, level, tilex, tiley);
+         if(bitmap != gs->background_tiles[tiley][tilex])
+         {
+            gs->background_tiles[tiley][tilex] = bitmap;
+            if(gs->is_background_cached)
             {
-               // NOTE(law): We don't handle every type here.
-            } break;
+               struct render_clip clip;
+               clip.minx = tilex * TILE_DIMENSION_PIXELS;
+               clip.miny = tiley * TILE_DIMENSION_PIXELS;
+               clip.maxx = MINIMUM(clip.minx + TILE_DIMENSION_PIXELS, gs->background.width);
+               clip.maxy = MINIMUM(clip.miny + TILE_DIMENSION_PIXELS, gs->background.height);
+
+               draw_background(gs, renderer, clip);
+            }
          }
       }
    }
 
+   if(!gs->is_background_cached)
+   {
+      struct render_clip clip = {0, 0, gs->background.width, gs->background.height};
+      draw_background(gs, renderer, clip);
+
+      gs->is_background_cached = true;
+   }
+
+   render_push_screen(bg, gs->background, 1.0f);
+
    TIMER_END(render_push_background);
 }
 
@@ -1178,7 +3208,7 @@ function void title_menu(struct game_state *gs, struct game_renderer *renderer,
    if(was_pressed(input->confirm))
    {
       gs->menu_state = MENU_STATE_NONE;
-      begin_level_transition(gs, renderer->output);
+      begin_level_transition(gs, renderer);
    }
 
    struct render_queue *fg = renderer->queue + RENDER_LAYER_FOREGROUND;
@@ -1192,8 +3222,10 @@ function void title_menu(struct game_state *gs, struct game_renderer *renderer,
    float posy = (float)render_output.height - TILE_DIMENSION_PIXELS;
    float height = (gs->font.ascent - gs->font.descent + gs->font.line_gap) * TILE_BITMAP_SCALE * 1.35f;
 
-   render_push_text(fg, &gs->font, posx, posy - 0.25f*height, "Press <Enter> to start");
-   render_push_text(fg, &gs->font, posx, posy - 1.25f*height, "SOKOBAN 2023 (WORKING TITLE)");
+   render_begin_batch(fg);
+   render_push_text(renderer, fg, &gs->font, posx, posy - 0.25f*height, "Press <Enter> to start");
+   render_push_text(renderer, fg, &gs->font, posx, posy - 1.25f*height, "SOKOBAN 2023 (WORKING TITLE)");
+   render_end_batch(fg);
 }
 
 function void pause_menu(struct game_state *gs, struct game_renderer *renderer, struct game_input *input)
@@ -1208,11 +3240,11 @@ function void pause_menu(struct game_state *gs, struct game_renderer *renderer,
    }
    else if(was_pressed(input->move_up))
    {
-      gs->level_index = (gs->level_index == 0) ? gs->level_count - 1 : gs->level_index - 1;
+      select_level(gs, (gs->level_index == 0) ? gs->level_count - 1 : gs->level_index - 1);
    }
    else if(was_pressed(input->move_down))
    {
-      gs->level_index = (gs->level_index == gs->level_count - 1) ? 0 : gs->level_index + 1;
+      select_level(gs, (gs->level_index == gs->level_count - 1) ? 0 : gs->level_index + 1);
    }
 
    struct render_queue *fg = renderer->queue + RENDER_LAYER_FOREGROUND;
@@ -1232,6 +3264,7 @@ function void pause_menu(struct game_state *gs, struct game_renderer *renderer,
       "<Ctrl> to dash (won't push)",
       "<Shift> to charge (will push)",
       "<u> to undo move",
+      "<y> to redo move",
       "<p> to pause",
       "<r> to restart level",
    };
@@ -1269,13 +3302,13 @@ function void pause_menu(struct game_state *gs, struct game_renderer *renderer,
       assert(entry_count > 0);
 
       // NOTE(law): Display the section header text outside the border.
-      render_push_text(fg, &gs->font, textx, texty, entries[0]);
+      render_push_text(renderer, fg, &gs->font, textx, texty, entries[0]);
       texty += line_height;
 
       v2 section_min = {textx, texty};
       for(u32 entry_index = 1; entry_index < entry_count; ++entry_index)
       {
-         render_push_text(bg, &gs->font, textx + section_padding, texty + section_padding, entries[entry_index]);
+         render_push_text(renderer, bg, &gs->font, textx + section_padding, texty + section_padding, entries[entry_index]);
          texty += line_height;
       }
       v2 section_max = {render_width - section_margin_x, texty + (2.0f * section_padding)};
@@ -1285,7 +3318,7 @@ function void pause_menu(struct game_state *gs, struct game_renderer *renderer,
    }
 
    // NOTE(law): Fill remaining space with level selection.
-   render_push_text(fg, &gs->font, textx, texty, "LEVELS");
+   render_push_text(renderer, fg, &gs->font, textx, texty, "LEVELS");
    texty += line_height;
 
    float remaining_section_height = render_height - texty - section_margin_y - section_padding;
@@ -1302,16 +3335,18 @@ function void pause_menu(struct game_state *gs, struct game_renderer *renderer,
 
    // NOTE(law): Render level names.
    v2 section_min = {textx, texty};
+   render_begin_batch(fg);
    for(u32 level_index = first_visible_index; level_index <= last_visible_index; ++level_index)
    {
       if(level_index < gs->level_count)
       {
          struct game_level *level = gs->levels[level_index];
          char *format = (level_index == gs->level_index) ? "->%02d. %s" : "  %02d. %s";
-         render_push_text(fg, &gs->font, textx + section_padding, texty + section_padding, format, level_index + 1, level->name);
+         render_push_text(renderer, fg, &gs->font, textx + section_padding, texty + section_padding, format, level_index + 1, level->name);
       }
       texty += line_height;
    }
+   render_end_batch(fg);
    v2 section_max = {render_width - section_margin_x, texty + (2.0f * section_padding)};
    render_push_outline(bg, section_min, section_max, border_color, border_thickness);
 
@@ -1437,6 +3472,53 @@ function void mix_sound_samples(struct game_state *gs, struct game_sound_output
    TIMER_END(mix_sound_samples);
 }
 
+function void load_artwork(struct game_state *gs)
+{
+   // NOTE(law): Allocate grass positions. The placements are generated in
+   // source pixels, so the same blades come out whatever scale the art is
+   // rasterized at.
+   gs->grass_cell_dimension = SOURCE_BITMAP_DIMENSION_PIXELS / 2;
+   gs->grass_grid_width  = (SCREEN_TILE_COUNT_X * SOURCE_BITMAP_DIMENSION_PIXELS) / gs->grass_cell_dimension;
+   gs->grass_grid_height = (SCREEN_TILE_COUNT_Y * SOURCE_BITMAP_DIMENSION_PIXELS) / gs->grass_cell_dimension;
+
+   gs->grass_positions.count = 0;
+   gs->grass_positions.samples = ALLOCATE_SIZE(&gs->arena, gs->grass_grid_width * gs->grass_grid_height * sizeof(v2));
+
+   // TODO(law): Generate distinct grass placements for individual
+   // levels. Right now noise generation is too slow to run on each level
+   // transition without momentarily missing the target frame rate.
+
+   // NOTE(law): Compute grass placements.
+   generate_blue_noise(&gs->grass_positions, &gs->entropy, &gs->arena,
+                       gs->grass_grid_width, gs->grass_grid_height, gs->grass_cell_dimension);
+
+   // NOTE(law): Snap each placement to a whole source pixel and convert it to
+   // output pixels.
+   for(u32 index = 0; index < gs->grass_positions.count; ++index)
+   {
+      v2 *sample = gs->grass_positions.samples + index;
+      sample->x = (float)((s32)sample->x * TILE_BITMAP_SCALE);
+      sample->y = (float)((s32)sample->y * TILE_BITMAP_SCALE);
+   }
+
+   // NOTE(law): Load bitmap assets.
+   gs->floor[FLOOR_TYPE_00] = load_bitmap(&gs->arena, "../data/artwork/floor00.bmp");
+   gs->floor[FLOOR_TYPE_01] = load_bitmap(&gs->arena, "../data/artwork/floor01.bmp");
+   gs->floor[FLOOR_TYPE_02] = load_bitmap(&gs->arena, "../data/artwork/floor02.bmp");
+   gs->floor[FLOOR_TYPE_03] = load_bitmap(&gs->arena, "../data/artwork/floor03.bmp");
+
+   gs->wall[WALL_TYPE_INTERIOR]  = load_bitmap(&gs->arena, "../data/artwork/wall.bmp");
+   gs->wall[WALL_TYPE_CORNER_NW] = load_bitmap(&gs->arena, "../data/artwork/wall_nw.bmp");
+   gs->wall[WALL_TYPE_CORNER_NE] = load_bitmap(&gs->arena, "../data/artwork/wall_ne.bmp");
+   gs->wall[WALL_TYPE_CORNER_SE] = load_bitmap(&gs->arena, "../data/artwork/wall_se.bmp");
+   gs->wall[WALL_TYPE_CORNER_SW] = load_bitmap(&gs->arena, "../data/artwork/wall_sw.bmp");
+
+   gs->player      = load_bitmap(&gs->arena, "../data/artwork/player.bmp");
+   gs->box         = load_bitmap(&gs->arena, "../data/artwork/box.bmp");
+   gs->box_on_goal = load_bitmap(&gs->arena, "../data/artwork/box_on_goal.bmp");
+   gs->goal        = load_bitmap(&gs->arena, "../data/artwork/goal.bmp");
+}
+
 function GAME_UPDATE(game_update)
 {
    TIMER_BEGIN(game_update);
@@ -1456,28 +3538,18 @@ function GAME_UPDATE(game_update)
       gs->arena.base_address = memory.base_address + sizeof(struct game_state);
       assert(gs->arena.size <= (memory.size + sizeof(struct game_state)));
 
+      // NOTE(law): Give the rest of game memory to an arena for memory that only
+      // lasts one frame, like the render queues.
+      assert((sizeof(struct game_state) + gs->arena.size) < memory.size);
+      gs->frame_arena.base_address = gs->arena.base_address + gs->arena.size;
+      gs->frame_arena.size = memory.size - sizeof(struct game_state) - gs->arena.size;
+
       // NOTE(law): Seed our random entropy.
       gs->entropy = random_seed(0x1234);
 
       // NOTE(law): Load any fonts we need.
       load_font(&gs->font, &gs->arena, "../data/atari.font");
 
-      // NOTE(law): Allocate grass positions.
-      gs->grass_cell_dimension = TILE_DIMENSION_PIXELS / 2;
-      gs->grass_grid_width  = (RESOLUTION_BASE_WIDTH / gs->grass_cell_dimension);
-      gs->grass_grid_height = (RESOLUTION_BASE_HEIGHT / gs->grass_cell_dimension);
-
-      gs->grass_positions.count = 0;
-      gs->grass_positions.samples = ALLOCATE_SIZE(&gs->arena, gs->grass_grid_width * gs->grass_grid_height * sizeof(v2));
-
-      // TODO(law): Generate distinct grass placements for individual
-      // levels. Right now noise generation is too slow to run on each level
-      // transition without momentarily missing the target frame rate.
-
-      // NOTE(law): Compute grass placements.
-      generate_blue_noise(&gs->grass_positions, &gs->entropy, &gs->arena,
-                          gs->grass_grid_width, gs->grass_grid_height, gs->grass_cell_dimension);
-
       // NOTE(law): Allocate, load, and store levels.
       for(u32 index = 0; index < ARRAY_LENGTH(gs->levels); ++index)
       {
@@ -1495,22 +3567,8 @@ function GAME_UPDATE(game_update)
       store_level(gs, "../data/levels/Lanky.sok");
       store_level(gs, "../data/levels/Empty Section.sok");
 
-      // NOTE(law): Load bitmap assets.
-      gs->floor[FLOOR_TYPE_00] = load_bitmap(&gs->arena, "../data/artwork/floor00.bmp");
-      gs->floor[FLOOR_TYPE_01] = load_bitmap(&gs->arena, "../data/artwork/floor01.bmp");
-      gs->floor[FLOOR_TYPE_02] = load_bitmap(&gs->arena, "../data/artwork/floor02.bmp");
-      gs->floor[FLOOR_TYPE_03] = load_bitmap(&gs->arena, "../data/artwork/floor03.bmp");
-
-      gs->wall[WALL_TYPE_INTERIOR]  = load_bitmap(&gs->arena, "../data/artwork/wall.bmp");
-      gs->wall[WALL_TYPE_CORNER_NW] = load_bitmap(&gs->arena, "../data/artwork/wall_nw.bmp");
-      gs->wall[WALL_TYPE_CORNER_NE] = load_bitmap(&gs->arena, "../data/artwork/wall_ne.bmp");
-      gs->wall[WALL_TYPE_CORNER_SE] = load_bitmap(&gs->arena, "../data/artwork/wall_se.bmp");
-      gs->wall[WALL_TYPE_CORNER_SW] = load_bitmap(&gs->arena, "../data/artwork/wall_sw.bmp");
-
-      gs->player      = load_bitmap(&gs->arena, "../data/artwork/player.bmp");
-      gs->box         = load_bitmap(&gs->arena, "../data/artwork/box.bmp");
-      gs->box_on_goal = load_bitmap(&gs->arena, "../data/artwork/box_on_goal.bmp");
-      gs->goal        = load_bitmap(&gs->arena, "../data/artwork/goal.bmp");
+      // NOTE(law): Generate grass and load bitmap assets.
+      load_artwork(gs);
 
       // NOTE(law): Load sound assets.
       gs->sine_sound = load_wave(&gs->arena, "../data/sounds/sine.wav");
@@ -1521,20 +3579,27 @@ function GAME_UPDATE(game_update)
       gs->level_transition.seconds_duration = 0.333333f;
 
       // NOTE(law): Allocate snapshot bitmap for fadeouts.
-      gs->snapshot.width  = render_width;
-      gs->snapshot.height = render_height;
-      gs->snapshot.memory = ALLOCATE_SIZE(&gs->arena, gs->snapshot.width * gs->snapshot.height * sizeof(u32));
+      gs->snapshot = allocate_render_bitmap(&gs->arena, render_width, render_height);
+
+      // NOTE(law): Allocate the cached level background. Its pixels are built
+      // on an opaque clear, so it can be copied rather than blended.
+      gs->background = allocate_render_bitmap(&gs->arena, render_width, render_height);
+      gs->background.opacity = RENDER_BITMAP_OPAQUE;
 
       // NOTE(law): Set the initial menu state.
       gs->menu_state = MENU_STATE_TITLE;
 
-      // NOTE(law): Load saved level from disk.
+      // NOTE(law): Load saved level and personal bests from disk.
       load_game(gs);
+      load_progress(gs);
 
       // NOTE(law): Add any required initialization above this point.
       gs->is_initialized = true;
    }
 
+   gs->frame_arena.used = 0;
+   begin_render_frame(renderer, &gs->frame_arena);
+
    if(was_pressed(input->function_keys[1]))
    {
       save_game(gs);
@@ -1545,6 +3610,11 @@ function GAME_UPDATE(game_update)
       load_game(gs);
    }
 
+   if(was_pressed(input->function_keys[3]))
+   {
+      import_solution(gs);
+   }
+
    if(gs->menu_state == MENU_STATE_TITLE)
    {
       // NOTE(law): Display title menu and early out.
@@ -1560,13 +3630,15 @@ function GAME_UPDATE(game_update)
       // NOTE(law): Activate pause menu and early out (displaying the pause menu
       // next frame).
       gs->menu_state = MENU_STATE_PAUSE;
-      snapshot_screen(gs, renderer->output);
+      snapshot_screen(gs, renderer);
    }
    else
    {
       // NOTE(law): Process the normal gameplay loop.
 
       struct game_level *level = gs->levels[gs->level_index];
+      level->seconds_elapsed += frame_seconds_elapsed;
+
       if(is_something_animating(gs))
       {
          decrement_animation_timers(gs, frame_seconds_elapsed);
@@ -1618,17 +3690,21 @@ function GAME_UPDATE(game_update)
          {
             pop_undo(gs);
          }
+         else if(was_pressed(input->redo))
+         {
+            pop_redo(gs);
+         }
          else if(was_pressed(input->reload))
          {
-            reload_level(gs, renderer->output);
+            reload_level(gs, renderer);
          }
          else if(was_pressed(input->next))
          {
-            level = next_level(gs, renderer->output);
+            level = next_level(gs, renderer);
          }
          else if(was_pressed(input->previous))
          {
-            level = previous_level(gs, renderer->output);
+            level = previous_level(gs, renderer);
          }
       }
 
@@ -1700,15 +3776,25 @@ function GAME_UPDATE(game_update)
       float textx = 0.5f * TILE_DIMENSION_PIXELS;
       float texty = 0.5f * line_height;
 
-      render_push_text(fg, &gs->font, textx, texty, "%s", level->name);
+      render_begin_batch(fg);
+
+      render_push_text(renderer, fg, &gs->font, textx, texty, "%s", level->name);
       texty += line_height;
 
-      render_push_text(fg, &gs->font, textx, texty, "Move Count: %u", level->move_count);
+      render_push_text(renderer, fg, &gs->font, textx, texty, "Move Count: %u", level->move_count);
       texty += line_height;
 
-      render_push_text(fg, &gs->font, textx, texty, "Push Count: %u", level->push_count);
+      render_push_text(renderer, fg, &gs->font, textx, texty, "Push Count: %u", level->push_count);
       texty += line_height;
 
+      if(has_level_best(gs, level))
+      {
+         render_push_text(renderer, fg, &gs->font, textx, texty, "Best: %u moves, %u pushes", level->best_move_count, level->best_push_count);
+         texty += line_height;
+      }
+
+      render_end_batch(fg);
+
       // NOTE(law): Render level transition overlay.
       if(is_animating(&gs->level_transition))
       {
@@ -1721,11 +3807,13 @@ function GAME_UPDATE(game_update)
       // frame of the box on the goal. Play some kind of animation instead.
       if(is_level_complete(gs))
       {
-         level = next_level(gs, renderer->output);
+         record_progress(gs);
+         export_solution(gs);
+         level = next_level(gs, renderer);
       }
    }
 
-   render(renderer);
+   render(renderer, queue);
    mix_sound_samples(gs, sound);
 
    TIMER_END(game_update);